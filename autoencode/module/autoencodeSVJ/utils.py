@@ -814,7 +814,8 @@ def get_cutflow_table(glob_path):
     ret = odict()
     for path in paths:
         with open(path) as f:
-            values_comp, keys_comp = map(lambda x: x.strip('\n').split(','), f.readlines())
+            # sampled runs add lines with their intervals after the counts and names
+            values_comp, keys_comp = map(lambda x: x.strip('\n').split(','), f.readlines()[:2])
             values_comp = map(int, values_comp)
             keys_comp = map(str.strip, ['no cut'] + keys_comp)
             for k,v in zip(keys_comp, values_comp):
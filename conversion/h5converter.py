@@ -16,6 +16,7 @@ rt.gInterpreter.Declare('#include "{}/include/modules/Delphes.h"'.format(DELPHES
 rt.gInterpreter.Declare('#include "{}/include/classes/DelphesClasses.h"'.format(DELPHES_DIR))
 rt.gInterpreter.Declare('#include "{}/include/classes/DelphesFactory.h"'.format(DELPHES_DIR))
 rt.gInterpreter.Declare('#include "{}/include/ExRootAnalysis/ExRootTreeReader.h"'.format(DELPHES_DIR))
+rt.gInterpreter.Declare('#include "{}"'.format(os.path.join(os.path.dirname(os.path.abspath(__file__)), "../selection/bin/SelectionReader.h")))
 
 def get_data_dict(list_of_selections):
     ret = {}
@@ -31,6 +32,15 @@ class Converter:
 
     LOGMSG = "Converter :: "
 
+    # branches read for every selected event; everything else stays on disk
+    READ_BRANCHES = [
+        "Jet*",
+        "MissingET*",
+        "EFlowTrack*",
+        "EFlowNeutralHadron*",
+        "EFlowPhoton*",
+    ]
+
     def __init__(
         self,
         outputdir,
@@ -345,38 +355,54 @@ class Converter:
 
         ftn = 0
 
-        # selection is implicit: looping only through total selectinos
-        for tree_n,tree_name in enumerate(self.inputfiles):
+        # selection is implicit: looping only through total selectinos. the reader visits them
+        # file by file in cluster order, and only reads the clusters and branches we need
+        branches = rt.std.vector('string')()
+        for branch in self.READ_BRANCHES:
+            branches.push_back(branch)
+        reader = rt.SelectionReader(branches)
+        for tree_name in self.inputfiles:
+            entries = rt.std.vector('Long64_t')()
+            for event_index in selections_iter[tree_name]:
+                entries.push_back(int(event_index))
+            reader.AddFile(tree_name, entries)
 
-            for event_n,event_index in enumerate(selections_iter[tree_name]):
+        while reader.Next():
 
-                self.log('tree {0}, event {1}, index {2}, total count {3}'.format(tree_n, event_n, event_index, total_count))
+            event_index = reader.Entry()
+            self.log('tree {0}, index {1}, total count {2}'.format(reader.File(), event_index, total_count))
 
-                # tree (and, get the entry)
-                tree = self.trees[tree_n]
-                tree.GetEntry(event_index)
+            # tree, at the selected entry
+            tree = reader.Tree()
 
-                # jets
-                jets_raw = [tree.Jet[i] for i in range(min([self.n_jets, tree.Jet_size]))]
-                jets = [j.P4() for j in jets_raw]
-               
-                # constituent 4-vectors per jet
-                constituents_by_jet = self.get_constituent_p4s(tree, jets, self.jetDR)
+            # jets
+            jets_raw = [tree.Jet[i] for i in range(min([self.n_jets, tree.Jet_size]))]
+            jets = [j.P4() for j in jets_raw]
+           
+            # constituent 4-vectors per jet
+            constituents_by_jet = self.get_constituent_p4s(tree, jets, self.jetDR)
 
-                self.event_features[total_count, :] = np.asarray(self.get_event_features(tree))
+            self.event_features[total_count, :] = np.asarray(self.get_event_features(tree))
 
-                for jet_n, (jet_raw, jet_p4, constituents) in enumerate(zip(jets_raw, jets, constituents_by_jet)):
+            for jet_n, (jet_raw, jet_p4, constituents) in enumerate(zip(jets_raw, jets, constituents_by_jet)):
+            
+                self.jet_features[total_count, jet_n, :] =  self.get_jet_features(jet_raw, constituents)
                 
-                    self.jet_features[total_count, jet_n, :] =  self.get_jet_features(jet_raw, constituents)
-                    
-                    if self.save_constituents:
-                        self.jet_constituents[total_count, jet_n, :] = self.get_jet_constituents(constituents)
-                    
-                    if self.save_eflow:
-                        self.energy_flow_bases[total_count, jet_n, :] = self.get_eflow_variables(constituents)
-
-                total_count += 1 
-        
+                if self.save_constituents:
+                    self.jet_constituents[total_count, jet_n, :] = self.get_jet_constituents(constituents)
+                
+                if self.save_eflow:
+                    self.energy_flow_bases[total_count, jet_n, :] = self.get_eflow_variables(constituents)
+
+            total_count += 1 
+
+        # the arrays above are uninitialised; rows of entries the reader could not get to would
+        # hold garbage, so refuse to go on rather than save them
+        failed = list(reader.Failed())
+        if failed or total_count != total_size:
+            raise RuntimeError("read {0} of {1} selected events; could not read {2}".format(total_count, total_size, ", ".join(failed) or "some entries"))
+
+        self.log("read {0} clusters ({1} bytes), skipped {2} clusters".format(reader.ClustersRead(), reader.BytesRead(), reader.ClustersSkipped()))
         return None
 
     def save(
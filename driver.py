@@ -96,6 +96,25 @@ def local_submit(
 ):
     os.system(master_command)
 
+def daemon_submit(
+    socket_path,
+    args,
+):
+    """sends a job to a selection service ('SVJselection --serve <socket_path>') and waits for it;
+    returns the reply type (RESULT or ERROR) and its text (see SelectionService::Summary)"""
+    import socket
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(socket_path)
+    payload = '\n'.join(args) + '\n'
+    s.sendall('JOB {0}\n'.format(len(payload)) + payload)
+    f = s.makefile('rb')
+    header = f.readline().split()
+    if len(header) != 2:
+        raise IOError("selection service at '{0}' closed the connection".format(socket_path))
+    reply = f.read(int(header[1]))
+    s.close()
+    return header[0], reply
+
 def split_to_chunks(l, n):
     for i in range(0, len(l), n):
         yield l[i:i+n]
@@ -176,7 +195,7 @@ def setup_parser():
     
     # selection args
     select.add_argument('-s', '--split-trees',  dest='split', action='store', type=int, default=-1, help='split trees into chunks of N')
-    select.add_argument('-i', '--input', dest="inputdir", action="store", type=_smartpath, help="input dir path", required=True)
+    select.add_argument('-i', '--input', dest="inputdir", action="store", type=_smartpath, help="input dir path; required unless --stream is given", required=False, default=None)
     select.add_argument('-f', '--filter', dest='filter', action='store', default='*', help='glob-style filter for root files in inputfile')
     select.add_argument('-r', '--range', dest='range', action='store', default=(-1,-1), type=_range_input, help='subset of tree values to parse')
     select.add_argument('-d', '--no-debug', dest='debug', action='store_false', default=True, help='disable debug output')
@@ -184,6 +203,27 @@ def setup_parser():
     select.add_argument('-c', '--no-save-cuts', dest='cuts', action='store_false', default=True, help='disable saving cut values')
     select.add_argument('-b', '--build', dest='build', action='store_true', default=False, help='rebuild cpp files before running')
     select.add_argument('-g', '--gdb', dest='gdb', action='store_true', default=False, help='run with gdb debugger :-)')
+    select.add_argument('-m', '--multi', dest='multi', action='store_true', default=False, help='run all splits in one job, sharing one worker pool')
+    select.add_argument('-p', '--threads', dest='threads', action='store', type=int, default=1, help='number of worker threads per job')
+    select.add_argument('-v', '--variations', dest='variations', action='store', type=_smartpath, default=None, help='file of named selection variations to run alongside the nominal selection')
+    select.add_argument('-x', '--scan', dest='scan', action='store', type=_smartpath, default=None, help='file of cuts and threshold grids to scan in the same pass')
+    select.add_argument('-w', '--workers', dest='workers', action='store', type=int, default=0, help='run a coordinator and this many local worker processes per job')
+    select.add_argument('--port', dest='port', action='store', type=int, default=5555, help='coordinator port for -w/--workers')
+    select.add_argument('--chunk', dest='chunk', action='store', type=int, default=0, help='entries per work unit for -w/--workers; 0 for whole files')
+    select.add_argument('-k', '--cache', dest='cache', action='store', type=_smartpath, default=None, help='directory of cached per-file results; only new or changed files are processed')
+    select.add_argument('--stage', dest='stage', action='store', type=_smartpath, default=None, help='local scratch directory to stage input files in before they are read')
+    select.add_argument('--stage-size', dest='stage_size', action='store', type=float, default=20., help='space in GB staged files may take')
+    select.add_argument('-q', '--sketch', dest='sketch', action='store', type=int, default=0, help='keep quantile sketches of size k (e.g. 200) of the key distributions; 0 for none')
+    select.add_argument('--npy', dest='npy', action='store_true', default=False, help='write derived variables of selected events to memory-mappable .npy files')
+    select.add_argument('--sample', dest='sample', action='store', type=float, default=0., help='run randomly ordered clusters only until every cutflow efficiency is known to this relative precision (e.g. 0.01); 0 runs everything')
+    select.add_argument('--stream', dest='stream', action='store', type=_smartpath, default=None, help='follow a growing file list, pipe or directory of files still being produced (renamed into place once closed), until an END marker, instead of the files in -i/--input')
+    select.add_argument('--constituents', dest='constituents', action='store', type=float, default=0., help='also write the EFlow constituents within this dR of the two leading jets of selected events, as ragged .npy files (implies --npy; read with selection/constituents.py)')
+    select.add_argument('--daemon', dest='daemon', action='store', type=_smartpath, default=None, help='send the jobs to a running selection service (started with SVJselection --serve <socket>) instead of starting the binary; it keeps files and caches open between runs')
+    select.add_argument('--recluster', dest='recluster', action='store', default=None, help='also recluster EFlow jets of selected events at these comma separated radii (e.g. 0.4,0.8,1.2) and histogram them')
+    select.add_argument('--recluster-alg', dest='recluster_alg', action='store', choices=['antikt', 'kt', 'ca'], default='antikt', help='jet algorithm for --recluster')
+    select.add_argument('--recluster-ptmin', dest='recluster_ptmin', action='store', type=float, default=20., help='pt (GeV) below which reclustered jets are dropped')
+    select.add_argument('--zones', dest='zones', action='store', type=_smartpath, default=None, help='directory of per-cluster zone maps of the inputs; files get one once every entry has been run, whole or in ranges, and clusters no event of which can pass a cut are skipped')
+    select.add_argument('--live', dest='live', action='store', type=_smartpath, default=None, help='directory (e.g. /dev/shm) for live snapshots of the cutflow and histograms of each job, <name>.live, updated while it runs; view them with selection/liveview.py. serial jobs only, not with threads, manifests, caches, workers or streams')
     # select.add_argument('-m', '--merge', dest='merge', action='store', type=int, default=-1, help='merge output data by tree groups of N')
 
     # conversion args
@@ -200,55 +240,124 @@ def setup_parser():
 
 # MAIN functions:
 
-def select_main(inputdir, outputdir, name, batch, filter, range, debug, timing, cuts, build, dryrun, gdb, split):
+def select_main(inputdir, outputdir, name, batch, filter, range, debug, timing, cuts, build, dryrun, gdb, split, multi, threads, variations, scan, workers, port, chunk, cache, stage, stage_size, sketch, npy, sample, stream, constituents, daemon, recluster, recluster_alg, recluster_ptmin, zones, live):
     log("running command 'select'")
     
     ffilter = str(filter)
     rng = range
 
-    if not ffilter.endswith(".root"):
-        ffilter += ".root"
-
-    # get list of samples, write to text file
-    criteria = os.path.join(inputdir, ffilter)
-    all_samplenames = glob(criteria)
-
-    if len(all_samplenames) == 0:
-        error("No samples found matching glob crieria '{0}'".format(criteria))
+    # one job following the stream, selecting each file as soon as it is closed
+    if stream is not None:
+        log("streaming input files from '{0}'".format(stream))
+        if not os.path.exists(outputdir):
+            log("making ouput directory '{0}'".format(outputdir))
+            os.makedirs(outputdir)
+        jobs = [(stream, name, ['--stream'])]
+    elif inputdir is None:
+        error("select needs -i/--input or --stream")
         sys.exit(1)
+    else:
+        if not ffilter.endswith(".root"):
+            ffilter += ".root"
 
-    if split < 0:
-        split = len(all_samplenames)
-    
-    split_samplenames = list(split_to_chunks(all_samplenames, split))
-
-
-    log("running {0} jobs with {1} rootfiles each".format(len(split_samplenames), split))
-    log("splits: {0}".format(map(len, split_samplenames)))
+        # get list of samples, write to text file
+        criteria = os.path.join(inputdir, ffilter)
+        all_samplenames = glob(criteria)
 
-    if not os.path.exists(outputdir):
-        log("making ouput directory '{0}'".format(outputdir))
-        os.makedirs(outputdir)
+        if len(all_samplenames) == 0:
+            error("No samples found matching glob crieria '{0}'".format(criteria))
+            sys.exit(1)
 
-    for i,samplenames in enumerate(split_samplenames):
+        if split < 0:
+            split = len(all_samplenames)
+    
+        split_samplenames = list(split_to_chunks(all_samplenames, split))
+
+
+        log("running {0} jobs with {1} rootfiles each".format(len(split_samplenames), split))
+        log("splits: {0}".format(map(len, split_samplenames)))
+
+        if not os.path.exists(outputdir):
+            log("making ouput directory '{0}'".format(outputdir))
+            os.makedirs(outputdir)
+
+        jobs = []
+        for i,samplenames in enumerate(split_samplenames):
+            name_sample = name + ('_' + str(i))
+            samplefile = os.path.join(outputdir, "{0}_filelist.txt".format(name_sample))
+            with open(samplefile, "w+") as sf:
+                log("writing samplefile to file '{0}'".format(samplefile))
+                for samplename in samplenames:
+                    sf.write(samplename + '\n')
+            jobs.append((samplefile, name_sample, []))
+
+        # one job for every split, with the splits as samples of a manifest
+        if multi:
+            manifest = os.path.join(outputdir, "{0}_manifest.txt".format(name))
+            with open(manifest, "w+") as mf:
+                log("writing manifest to file '{0}'".format(manifest))
+                for samplefile,name_sample,_ in jobs:
+                    mf.write("{0} {1}\n".format(name_sample, samplefile))
+            jobs = [(manifest, name, ['--manifest'])]
+
+    for i,(samplefile,name_sample,flags) in enumerate(jobs):
         log("------------------------------------------")
-        log("  PERFORMING SELECTION ON SAMPLE {0}/{1}".format(i + 1, len(split_samplenames)))
+        log("  PERFORMING SELECTION ON SAMPLE {0}/{1}".format(i + 1, len(jobs)))
         log("------------------------------------------")
 
-        name_sample = name + ('_' + str(i))
-        samplefile = os.path.join(outputdir, "{0}_filelist.txt".format(name_sample))
-        with open(samplefile, "w+") as sf:
-            log("writing samplefile to file '{0}'".format(samplefile))
-            for samplename in samplenames:
-                sf.write(samplename + '\n')
-
         path = os.path.abspath(os.path.dirname(__file__))
         setup_command = "source {0}".format(os.path.join(path, "selection/setup.sh"))
 
         if build:
             setup_command += "; cd {0}; cd ../..; scram b -j 10; cd {1}".format(path, path)
+
+        if threads > 1:
+            flags = flags + ['--threads', str(threads)]
+        if variations is not None:
+            flags = flags + ['--variations', variations]
+        if scan is not None:
+            flags = flags + ['--scan', scan]
+        if cache is not None:
+            flags = flags + ['--cache', cache]
+        if stage is not None:
+            flags = flags + ['--stage', stage, '--stage-size', str(stage_size)]
+        if sketch > 0:
+            flags = flags + ['--sketch', str(sketch)]
+        if npy:
+            flags = flags + ['--npy']
+        if sample > 0:
+            flags = flags + ['--sample', str(sample)]
+        if constituents > 0:
+            flags = flags + ['--constituents', str(constituents)]
+        if recluster is not None:
+            flags = flags + ['--recluster', recluster, '--recluster-alg', recluster_alg, '--recluster-ptmin', str(recluster_ptmin)]
+        if zones is not None:
+            flags = flags + ['--zones', zones]
+        if live is not None:
+            flags = flags + ['--live', os.path.join(live, "{0}.live".format(name_sample))]
             
-        run_command = 'cd {0}; ../../bin/sl*/SVJselection '.format(path) + ' '.join([samplefile, name_sample, outputdir] + list(map(lambda x: str(int(x)), [debug, timing, cuts, rng[0], rng[1]])))
+        # a running service does the job, with the same arguments the binary would get
+        if daemon is not None:
+            job = [samplefile, name_sample, outputdir] + list(map(lambda x: str(int(x)), [debug, timing, cuts, rng[0], rng[1]])) + flags
+            if dryrun:
+                log("DRYRUN: job for the selection service at '{0}' is:".format(daemon))
+                log(' '.join(job))
+            else:
+                kind, reply = daemon_submit(daemon, job)
+                if kind == 'RESULT':
+                    # histograms, selected entries and trees are for programs, the rest for people
+                    log('\n'.join(l for l in reply.strip().split('\n') if l.split(' ')[0] not in ('hist', 'selection', 'tree')))
+                else:
+                    error(reply.strip())
+            continue
+
+        run_command = 'cd {0}; ../../bin/sl*/SVJselection '.format(path) + ' '.join([samplefile, name_sample, outputdir] + list(map(lambda x: str(int(x)), [debug, timing, cuts, rng[0], rng[1]])) + flags)
+
+        # coordinator in the background, local workers connecting to it, then wait for all of them
+        if workers > 0:
+            coordinator = run_command + ' --coordinator {0}'.format(port) + (' --chunk {0}'.format(chunk) if chunk > 0 else '')
+            worker = run_command + ' --worker localhost:{0}'.format(port)
+            run_command = ' '.join(['(' + coordinator + ') &'] + ['(' + worker + ' > /dev/null) &']*workers + ['wait'])
         master_command = setup_command + "; " + run_command
 
         if dryrun:
@@ -0,0 +1,140 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using std::map;
+
+// one image: the histograms it overlays, in drawing order
+struct PlotSpec {
+    string name;
+    vector<string> hists;
+};
+
+// '<image name>: <hist> [<hist> ...]' lines; hists may be paths into the file, e.g. 'jes_up/h_Mt'
+vector<PlotSpec> readSpec(string specfile) {
+    vector<PlotSpec> spec;
+    std::ifstream f(specfile.c_str());
+    if (!f.is_open()) {
+        cout << "ERROR: could not open plot spec '" << specfile << "'" << endl;
+        return spec;
+    }
+    string line;
+    while (getline(f, line)) {
+        size_t colon = line.find(':');
+        if (line.empty() || line[0] == '#' || colon == string::npos)
+            continue;
+        PlotSpec p;
+        std::stringstream name(line.substr(0, colon)), hists(line.substr(colon + 1));
+        name >> p.name;
+        string h;
+        while (hists >> h)
+            p.hists.push_back(h);
+        if (!p.name.empty() && !p.hists.empty())
+            spec.push_back(p);
+    }
+    return spec;
+}
+
+// reads every histogram the spec needs from one file, each once, and closes the file. the
+// histograms are detached from it, so the cache is all that is held while rendering
+map<string, TH1*> loadHists(string filename, const vector<PlotSpec> & spec) {
+    map<string, TH1*> cache;
+    TFile *f = TFile::Open(filename.c_str());
+    if (f == nullptr || f->IsZombie()) {
+        cout << "ERROR: could not open '" << filename << "'" << endl;
+        delete f;
+        return cache;
+    }
+    for (size_t i = 0; i < spec.size(); ++i) {
+        for (size_t j = 0; j < spec[i].hists.size(); ++j) {
+            const string & name = spec[i].hists[j];
+            if (cache.count(name))
+                continue;
+            TH1 *h = nullptr;
+            f->GetObject(name.c_str(), h);
+            if (h != nullptr)
+                h->SetDirectory(0);
+            else
+                cout << "WARNING: no histogram '" << name << "' in '" << filename << "'" << endl;
+            cache[name] = h;
+        }
+    }
+    f->Close();
+    delete f;
+    return cache;
+}
+
+// draws one image from cached histograms; everything it creates is freed before returning
+void render(const PlotSpec & p, map<string, TH1*> & cache, string outpath) {
+    const int colors[] = {kRed, kOrange, kBlue, kBlack, kGreen + 2, kMagenta};
+    THStack *hs = new THStack("hs", p.name.c_str());
+    TLegend *legend = new TLegend(0.6, 0.7, .95, .92);
+    size_t drawn = 0;
+    for (size_t i = 0; i < p.hists.size(); ++i) {
+        TH1 *h = cache[p.hists[i]];
+        if (h == nullptr)
+            continue;
+        h->SetLineColor(colors[drawn++ % 6]);
+        h->SetLineStyle(p.hists[i].find("post") != string::npos ? 2 : 1);
+        hs->Add(h, "HIST");
+        legend->AddEntry(h, h->GetTitle(), "l");
+    }
+
+    if (drawn > 0) {
+        TCanvas *cst = new TCanvas("cst", "stacked hists", 10, 10, 700, 700);
+        cst->cd();
+        hs->Draw("nostack");
+        if (drawn > 1)
+            legend->Draw();
+        cout << "saving image to path '" << outpath << "'" << endl;
+        cst->Print(outpath.c_str());
+        delete cst;
+    }
+    delete legend;
+    delete hs;
+}
+
+// renders every plot in specfile for the sample outputs listed in listfile, one per line. with
+// nworkers > 1, this process only takes every nworkers-th file starting at worker, so several can
+// run side by side (see batchplot.py). one file's histograms are in memory at a time
+int batchplot(string listfile, string specfile, string outputpath, int worker=0, int nworkers=1) {
+    gROOT->SetBatch(kTRUE);
+    TH1::AddDirectory(kFALSE);
+
+    vector<PlotSpec> spec = readSpec(specfile);
+    if (spec.empty())
+        return 1;
+
+    std::ifstream list(listfile.c_str());
+    if (!list.is_open()) {
+        cout << "ERROR: could not open file list '" << listfile << "'" << endl;
+        return 1;
+    }
+
+    string filename;
+    for (int i = 0; getline(list, filename); ++i) {
+        if (filename.empty() || i % nworkers != worker)
+            continue;
+
+        // <sample>_output.root -> <outputpath><sample>_<plot>.png
+        string sample = filename.substr(filename.rfind('/') + 1);
+        size_t suffix = sample.rfind("_output.root");
+        sample = sample.substr(0, suffix != string::npos ? suffix : sample.rfind(".root"));
+
+        map<string, TH1*> cache = loadHists(filename, spec);
+        if (cache.empty())
+            continue;
+        for (size_t j = 0; j < spec.size(); ++j)
+            render(spec[j], cache, outputpath + sample + "_" + spec[j].name + ".png");
+        for (map<string, TH1*>::iterator it = cache.begin(); it != cache.end(); ++it)
+            delete it->second;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+import sys
+import argparse
+import os
+import subprocess
+import tempfile
+import multiprocessing
+from glob import glob
+
+if __name__=="__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument('FILES', nargs='+', help="sample output files, or directories holding *_output.root files")
+    parser.add_argument('-s', '--spec', dest='spec', help='plot spec file', default=None, type=str)
+    parser.add_argument('-o', '--output', dest='out', help='output path', default='.', type=str)
+    parser.add_argument('-j', '--jobs', dest='jobs', help='number of root processes', default=multiprocessing.cpu_count(), type=int)
+    args = parser.parse_args(sys.argv[1:])
+    out = os.path.abspath(args.out) + '/'
+    curpath = os.path.abspath(os.path.dirname(__file__))
+    plotfile = os.path.join(curpath, "batchplot.cpp")
+    spec = os.path.abspath(args.spec or os.path.join(curpath, "batchplot.txt"))
+
+    files = []
+    for f in args.FILES:
+        if os.path.isdir(f):
+            files += sorted(glob(os.path.join(f, "*_output.root")))
+        else:
+            files.append(f)
+    files = [os.path.abspath(f) for f in files]
+    missing = [f for f in files if not os.path.exists(f)]
+    assert len(missing) == 0, "FILES given do not exist: {0}".format(", ".join(missing))
+    assert len(files) > 0, "no sample outputs found in {0}".format(", ".join(args.FILES))
+
+    if not os.path.exists(out):
+        os.makedirs(out)
+
+    listfile = tempfile.NamedTemporaryFile(suffix=".txt", delete=False)
+    listfile.write("\n".join(files) + "\n")
+    listfile.close()
+
+    # each process renders every jobs-th file in batch mode, holding one file's histograms at a time
+    jobs = max(1, min(args.jobs, len(files)))
+    print "plotting {0} samples with {1} processes".format(len(files), jobs)
+    procs = [subprocess.Popen(["root", "-b", "-q", "-l", '{0}("{1}", "{2}", "{3}", {4}, {5})'.format(plotfile, listfile.name, spec, out, i, jobs)]) for i in range(jobs)]
+    failed = [i for i,p in enumerate(procs) if p.wait() != 0]
+    os.remove(listfile.name)
+    if len(failed) > 0:
+        print "processes {0} failed".format(", ".join(map(str, failed)))
+        sys.exit(1)
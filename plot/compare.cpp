@@ -1,79 +1,187 @@
 #include <string>
 #include <iostream>
 #include <vector>
-#include <algorithm> 
+#include <algorithm>
+#include <thread>
+#include <limits>
 
 using namespace std;
 
 const string newname = "/eos/project/d/dshep/TOPCLASS/DijetAnomaly/ZprimeDark_2000GeV_13TeV_PU40/ZprimeDark_2000GeV_13TeV_PU40_1_ap.root";
 const string oldname = "/eos/project/d/dshep/TOPCLASS/DijetAnomaly/ZprimeDark_2000GeV_13TeV_PU40/ZprimeDark_2000GeV_13TeV_PU40_0.root";
 
-TCanvas *PlotTwo(TTree* tree1, TTree* tree2, string name, int bins, string f1label, string f2label) {
+// evaluates a list of expressions over one tree, with the selection applied per instance. only the
+// branches the formulas use are read (TTreeFormula loads its own leaves), through a TTreeCache
+// trained on exactly those branches
+class TreePass {
+public:
+    TreePass(string filename, string treename, const vector<string> & names, string selection) : names(names) {
+        file = new TFile(filename.c_str());
+        tree = (TTree*)file->Get(treename.c_str());
+        if (tree == nullptr) {
+            cout << "ERROR: no tree '" << treename << "' in '" << filename << "'" << endl;
+            return;
+        }
+        for (size_t i = 0; i < names.size(); ++i)
+            formulas.push_back(new TTreeFormula(("f" + to_string(i)).c_str(), names[i].c_str(), tree));
+        cut = new TTreeFormula("cut", selection.c_str(), tree);
+
+        tree->SetCacheSize(50000000);
+        vector<TTreeFormula*> all(formulas);
+        all.push_back(cut);
+        for (size_t i = 0; i < all.size(); ++i)
+            for (int j = 0; j < all[i]->GetNcodes(); ++j)
+                if (all[i]->GetLeaf(j) != nullptr)
+                    tree->AddBranchToCache(all[i]->GetLeaf(j)->GetBranch(), kTRUE);
+        tree->StopCacheLearningPhase();
+
+        low.assign(names.size(), numeric_limits<double>::max());
+        high.assign(names.size(), -numeric_limits<double>::max());
+    }
+
+    ~TreePass() {
+        for (size_t i = 0; i < formulas.size(); ++i)
+            delete formulas[i];
+        delete cut;
+        file->Close();
+    }
+
+    // first pass: ranges of the selected values of every expression
+    void FindRanges() {
+        Loop([this](size_t v, double x, double) {
+            low[v] = std::min(low[v], x);
+            high[v] = std::max(high[v], x);
+        });
+    }
+
+    // second pass: fills hists[v] with the selected values of expression v
+    void Fill(const vector<TH1F*> & hists) {
+        Loop([&hists](size_t v, double x, double w) {
+            hists[v]->Fill(x, w);
+        });
+    }
 
-    float min1 = tree1->GetMinimum(name.c_str());
-    float min2 = tree2->GetMinimum(name.c_str()); 
+    bool ok() {
+        return tree != nullptr;
+    }
 
-    float max1 = tree1->GetMaximum(name.c_str());
-    float max2 = tree1->GetMaximum(name.c_str());
+    vector<double> low, high;
+
+private:
+    template<typename f>
+    void Loop(f use) {
+        if (tree == nullptr)
+            return;
+        Long64_t n = tree->GetEntries();
+        for (Long64_t entry = 0; entry < n; ++entry) {
+            tree->LoadTree(entry);
+            int ncut = cut->GetNdata();
+            bool scalar = cut->GetMultiplicity() == 0;
+            for (size_t v = 0; v < formulas.size(); ++v) {
+                // instance i of the selection belongs to instance i of the expression, so only
+                // instances both have are used; a scalar selection applies to all of them
+                int ndata = formulas[v]->GetNdata();
+                if (!scalar)
+                    ndata = std::min(ndata, ncut);
+                for (int i = 0; i < ndata; ++i) {
+                    double w = ncut > 0 ? cut->EvalInstance(scalar ? 0 : i) : 0;
+                    if (w != 0)
+                        use(v, formulas[v]->EvalInstance(i), w);
+                }
+            }
+        }
+    }
 
-    float min = std::min(min1, min2);
-    float max = std::max(max1, max2); 
+    vector<string> names;
+    TFile* file = nullptr;
+    TTree* tree = nullptr;
+    vector<TTreeFormula*> formulas;
+    TTreeFormula* cut = nullptr;
+};
 
-    TH1F * h1 = new TH1F("h1", "h1", bins, min, max);
-    TH1F * h2 = new TH1F("h2", "h2", bins, min, max);
+TCanvas *PlotTwo(TH1F* h1, TH1F* h2, string name, string f1label, string f2label) {
 
-    tree1->Draw((name + ">>h1").c_str(), "Jet.PT>0", "goff");
-    tree2->Draw((name + ">>h2").c_str(), "Jet.PT>0", "goff");
-    
-    h1->Scale(1./h1->Integral());
-    h2->Scale(1./h2->Integral());
+    if (h1->Integral() > 0)
+        h1->Scale(1./h1->Integral());
+    if (h2->Integral() > 0)
+        h2->Scale(1./h2->Integral());
 
     // h1->SetMarkerSize(0)/
 
     TCanvas *cst = new TCanvas("cst");
     auto legend = new TLegend(0.6, 0.7, .95, .92);
 
-    THStack *hs = new THStack("hs", name.c_str()); 
+    THStack *hs = new THStack("hs", name.c_str());
 
     // h1->SetMarkerStyle(21);
     h1->SetLineColor(kBlue);
-    h1->SetLineStyle(1); 
+    h1->SetLineStyle(1);
 
     // h2->SetMarkerStyle(21);
     h2->SetLineColor(kRed);
-    h2->SetLineStyle(1); 
+    h2->SetLineStyle(1);
 
 
     hs->Add(h1, "HIST");
     hs->Add(h2, "HIST");
 
     cst->cd();
-    hs->Draw("nostack"); 
+    hs->Draw("nostack");
+
+    // legend->SetHeader("","C");
+    legend->AddEntry(h1, f1label.c_str(), "f");
+    legend->AddEntry(h2, f2label.c_str(), "f");
+    legend->Draw();
+
+    return cst;
+}
 
-    // legend->SetHeader("","C"); 
-    legend->AddEntry(h1, f1label.c_str(), "f"); 
-    legend->AddEntry(h2, f2label.c_str(), "f"); 
-    legend->Draw(); 
+// compares the distributions of every expression in names between two files. both trees are read
+// at the same time on their own threads, in two passes in total: one for the common ranges of all
+// expressions, one to fill all the histograms
+void compare(string f1name, string f2name, vector<string> names, string f1label="old signal", string f2label="new signal", string treename="Delphes", int bins=100, string selection="Jet.PT>0") {
 
-    return cst; 
-} 
+    ROOT::EnableThreadSafety();
+    TH1::AddDirectory(kFALSE);
 
-void compare(string f1name, string f2name, vector<string> names, string f1label="old signal", string f2label="new signal", string treename="Delphes", int bins=100) {
+    TreePass pass1(f1name, treename, names, selection);
+    TreePass pass2(f2name, treename, names, selection);
+    if (!pass1.ok() || !pass2.ok())
+        return;
 
-    TFile * f1 = new TFile(f1name.c_str());
-    TFile * f2 = new TFile(f2name.c_str());
+    thread t1(&TreePass::FindRanges, &pass1);
+    thread t2(&TreePass::FindRanges, &pass2);
+    t1.join();
+    t2.join();
+
+    vector<TH1F*> h1, h2;
+    for (size_t i = 0; i < names.size(); ++i) {
+        double min = std::min(pass1.low[i], pass2.low[i]);
+        double max = std::max(pass1.high[i], pass2.high[i]);
+        if (min > max) {
+            min = 0;
+            max = 1;
+        }
+        // keep the largest value out of the overflow bin
+        max += (max > min ? (max - min) : 1.)*1e-6;
+        h1.push_back(new TH1F(("h1_" + to_string(i)).c_str(), "h1", bins, min, max));
+        h2.push_back(new TH1F(("h2_" + to_string(i)).c_str(), "h2", bins, min, max));
+    }
 
-    TTree * tree1 = (TTree*)f1->Get(treename.c_str());
-    TTree * tree2 = (TTree*)f2->Get(treename.c_str());
+    thread u1(&TreePass::Fill, &pass1, std::cref(h1));
+    thread u2(&TreePass::Fill, &pass2, std::cref(h2));
+    u1.join();
+    u2.join();
 
     for (size_t i = 0; i < names.size(); ++i) {
-        string name = names[i]; 
+        string name = names[i];
         TImage *img = TImage::Create();
-        TCanvas* canvas = PlotTwo(tree1, tree2, name, bins, f1label, f2label); 
+        TCanvas* canvas = PlotTwo(h1[i], h2[i], name, f1label, f2label);
         img->FromPad(canvas);
-        string outpath = name + ".png"; 
+        string outpath = name + ".png";
         cout << "saving image to file '" << outpath << "'" << endl;
-        img->WriteImage(outpath.c_str()); 
+        img->WriteImage(outpath.c_str());
         delete img;
+        delete canvas;
     }
-}
\ No newline at end of file
+}
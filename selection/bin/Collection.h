@@ -0,0 +1,354 @@
+#pragma once
+
+#include "TTree.h"
+#include "TLeaf.h"
+#include "TLeafElement.h"
+#include "TLorentzVector.h"
+#include "TLorentzMock.h"
+#include "LeafLayout.h"
+#include "JetClustering.h"
+#include <array>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+
+using std::string;
+using std::vector;
+
+namespace Collections {
+
+    // name of the basic type backing a leaf, checked against the tree when binding
+    template<typename t> struct StorageName;
+    template<> struct StorageName<Float_t> { static const char* value() { return "Float_t"; } };
+    template<> struct StorageName<Double_t> { static const char* value() { return "Double_t"; } };
+    template<> struct StorageName<Int_t> { static const char* value() { return "Int_t"; } };
+    template<> struct StorageName<UInt_t> { static const char* value() { return "UInt_t"; } };
+
+    // builds one element of a collection from its components, in registration order
+    template<typename element>
+    struct Builder {
+        template<typename... args>
+        static element Make(args... a) {
+            return element(a...);
+        }
+    };
+
+    template<>
+    struct Builder<TLorentzVector> {
+        static TLorentzVector Make(Double_t pt, Double_t eta, Double_t phi, Double_t m) {
+            TLorentzVector v;
+            v.SetPtEtaPhiM(pt, eta, phi, m);
+            return v;
+        }
+    };
+
+    template<>
+    struct Builder<vector<double>> {
+        template<typename... args>
+        static vector<double> Make(args... a) {
+            return vector<double>{double(a)...};
+        }
+    };
+
+    // element printers, used by SVJFinder::Current
+    inline void Print(std::ostream & out, double v) { out << v; }
+    inline void Print(std::ostream & out, TLorentzMock v) { out << "(Pt,Eta)=(" << v.Pt() << "," << v.Eta() << ")"; }
+    inline void Print(std::ostream & out, const TLorentzVector & v) { out << "(Pt,Eta,Phi,M)=(" << v.Pt() << "," << v.Eta() << "," << v.Phi() << "," << v.M() << ")"; }
+    inline void Print(std::ostream & out, const vector<double> & v) {
+        out << "{ ";
+        for (size_t i = 0; i < v.size(); ++i)
+            out << v[i] << (i + 1 < v.size() ? ", " : " ");
+        out << "}";
+    }
+
+    // type-erased handle, so SVJFinder can bind and load every registered collection in one loop
+    class CollectionBase {
+    public:
+        CollectionBase(string name) : name(name) {}
+        virtual ~CollectionBase() {}
+
+        // resolve all component leaves in a newly opened tree, through the layout of its schema
+        virtual void Bind(LeafLayout & layout) = 0;
+
+        // reads the branches of the bound leaves at an entry of their tree. only these branches
+        // are decompressed, so collections which are not read cost nothing
+        virtual void Read(Long64_t entry) {
+            for (size_t i = 0; i < branches.size(); ++i)
+                branches[i]->GetEntry(entry);
+        }
+
+        // decode the entry last read
+        virtual void Load() = 0;
+
+        // empties the values, for entries on which the collection is not read
+        virtual void Clear() = 0;
+
+        virtual void Print(std::ostream & out, const string & prefix) const = 0;
+
+        const string name;
+
+        // 1 to be read for every entry, 2 to only be read for entries passing the preselection, 3
+        // to only be read on request (SVJFinder::LoadLate)
+        int stage = 1;
+
+    protected:
+        // checks the leaf against the registered storage type, and returns true if it hands out a
+        // contiguous array of it. members of split object branches (TLeafElement, e.g. every
+        // component of a delphes TClonesArray) report the type of the member, but their values
+        // sit in the objects of the array, so they are read element by element through GetValue.
+        // on delphes input that is every collection component; only plain leaves take the direct
+        // path
+        template<typename storage>
+        bool BindLeaf(LeafLayout & layout, const string & component, TLeaf* & leaf) {
+            leaf = layout.Find(component);
+            if (leaf == nullptr)
+                throw "Tree does not contain leaf '" + component + "'";
+            if (std::find(branches.begin(), branches.end(), leaf->GetBranch()) == branches.end())
+                branches.push_back(leaf->GetBranch());
+            if (string(leaf->GetTypeName()) != StorageName<storage>::value())
+                throw "Leaf '" + component + "' has type " + leaf->GetTypeName() + ", registered as " + StorageName<storage>::value();
+            return dynamic_cast<TLeafElement*>(leaf) == nullptr;
+        }
+
+        // the distinct branches of the bound leaves
+        vector<TBranch*> branches;
+    };
+
+    // a collection of elements, each built from one entry of every component leaf. the component
+    // storage types are fixed at compile time, so loading never switches on type or arity
+    template<typename element, typename... storage>
+    class Collection : public CollectionBase {
+        static_assert(sizeof...(storage) > 0, "collections need at least one component");
+    public:
+        static const size_t N = sizeof...(storage);
+        typedef std::array<string, N> Components;
+        typedef vector<element> Values;
+
+        Collection(string name, Components components) : CollectionBase(name), components(components) {
+            leaves.fill(nullptr);
+        }
+
+        Values* Get() {
+            return &values;
+        }
+
+        void Bind(LeafLayout & layout) override {
+            branches.clear();
+            BindAll(layout, std::index_sequence_for<storage...>());
+        }
+
+        void Load() override {
+            size_t n = leaves[0]->GetLen();
+            values.clear();
+            values.reserve(n);
+            if (direct)
+                LoadDirect(n, std::index_sequence_for<storage...>());
+            else
+                LoadElement(n, std::index_sequence_for<storage...>());
+        }
+
+        void Clear() override {
+            values.clear();
+        }
+
+        void Print(std::ostream & out, const string & prefix) const override {
+            for (size_t i = 0; i < values.size(); ++i) {
+                out << prefix;
+                Collections::Print(out, values[i]);
+                out << std::endl;
+            }
+        }
+
+    private:
+        template<size_t... i>
+        void BindAll(LeafLayout & layout, std::index_sequence<i...>) {
+            bool isDirect[] = { BindLeaf<storage>(layout, components[i], leaves[i])... };
+            direct = true;
+            for (size_t j = 0; j < N; ++j)
+                direct = direct && isDirect[j];
+        }
+
+        // basic leaves: read straight from the leaf buffers
+        template<size_t... i>
+        void LoadDirect(size_t n, std::index_sequence<i...>) {
+            std::tuple<const storage*...> data(static_cast<const storage*>(leaves[i]->GetValuePointer())...);
+            for (size_t j = 0; j < n; ++j)
+                values.push_back(Builder<element>::Make(std::get<i>(data)[j]...));
+        }
+
+        // split object branches (e.g. delphes TClonesArrays) only expose values through the leaf,
+        // one virtual GetValue per element and component
+        template<size_t... i>
+        void LoadElement(size_t n, std::index_sequence<i...>) {
+            for (size_t j = 0; j < n; ++j)
+                values.push_back(Builder<element>::Make(storage(leaves[i]->GetValue(j))...));
+        }
+
+        Components components;
+        std::array<TLeaf*, N> leaves;
+        bool direct = false;
+        Values values;
+    };
+
+    // a single value, read from the first entry of a leaf
+    template<typename storage>
+    class Scalar : public CollectionBase {
+    public:
+        Scalar(string name, string component) : CollectionBase(name), component(component) {}
+
+        double* Get() {
+            return &value;
+        }
+
+        void Bind(LeafLayout & layout) override {
+            branches.clear();
+            direct = BindLeaf<storage>(layout, component, leaf);
+        }
+
+        void Load() override {
+            if (direct)
+                value = *static_cast<const storage*>(leaf->GetValuePointer());
+            else
+                value = leaf->GetValue(0);
+        }
+
+        void Clear() override {
+            value = 0;
+        }
+
+        void Print(std::ostream & out, const string & prefix) const override {
+            out << prefix << value << std::endl;
+        }
+
+    private:
+        string component;
+        TLeaf* leaf = nullptr;
+        bool direct = false;
+        double value = 0;
+    };
+
+    // common schemas
+    typedef Collection<TLorentzVector, Float_t, Float_t, Float_t, Float_t> Lorentz;
+    template<typename... storage> using Mock = Collection<TLorentzMock, storage...>;
+    template<typename... storage> using Map = Collection<vector<double>, storage...>;
+    template<typename storage> using VectorVar = Collection<double, storage>;
+
+    // the EFlow objects of an entry which pass the converter's thresholds, as one vector: tracks
+    // above 0.1 GeV pt (taken as massless), neutral hadrons above 0.5 GeV and photons above 0.2 GeV
+    // et. the input of reclustering and of the stored jet constituents
+    class EFlow : public CollectionBase {
+    public:
+        EFlow(string name) :
+            CollectionBase(name),
+            tracks(name + "_tracks", {"EFlowTrack.PT", "EFlowTrack.Eta", "EFlowTrack.Phi"}),
+            neutralHadrons(name + "_neutralHadrons", {"EFlowNeutralHadron.ET", "EFlowNeutralHadron.Eta", "EFlowNeutralHadron.Phi", "EFlowNeutralHadron.E"}),
+            photons(name + "_photons", {"EFlowPhoton.ET", "EFlowPhoton.Eta", "EFlowPhoton.Phi", "EFlowPhoton.E"}) {}
+
+        vector<TLorentzVector>* Get() {
+            return &constituents;
+        }
+
+        void Bind(LeafLayout & layout) override {
+            tracks.Bind(layout);
+            neutralHadrons.Bind(layout);
+            photons.Bind(layout);
+        }
+
+        void Read(Long64_t entry) override {
+            tracks.Read(entry);
+            neutralHadrons.Read(entry);
+            photons.Read(entry);
+        }
+
+        void Load() override {
+            tracks.Load();
+            neutralHadrons.Load();
+            photons.Load();
+            constituents.clear();
+            TLorentzVector v;
+            for (const vector<double> & t : *tracks.Get()) {
+                if (t[0] > 0.1) {
+                    v.SetPtEtaPhiM(t[0], t[1], t[2], 0.);
+                    constituents.push_back(v);
+                }
+            }
+            for (const vector<double> & t : *neutralHadrons.Get()) {
+                if (t[0] > 0.5) {
+                    v.SetPtEtaPhiE(t[0], t[1], t[2], t[3]);
+                    constituents.push_back(v);
+                }
+            }
+            for (const vector<double> & t : *photons.Get()) {
+                if (t[0] > 0.2) {
+                    v.SetPtEtaPhiE(t[0], t[1], t[2], t[3]);
+                    constituents.push_back(v);
+                }
+            }
+        }
+
+        void Clear() override {
+            constituents.clear();
+        }
+
+        void Print(std::ostream & out, const string & prefix) const override {
+            for (size_t i = 0; i < constituents.size(); ++i) {
+                out << prefix;
+                Collections::Print(out, constituents[i]);
+                out << std::endl;
+            }
+        }
+
+    private:
+        Map<Float_t, Float_t, Float_t> tracks;
+        Map<Float_t, Float_t, Float_t, Float_t> neutralHadrons, photons;
+        vector<TLorentzVector> constituents;
+    };
+
+    // jets above ptMin reclustered from the constituents of an EFlow collection, one vector of
+    // jets per radius. reads no branches itself, so it has to be loaded after the EFlow collection
+    class Reclustered : public CollectionBase {
+    public:
+        Reclustered(string name, const vector<TLorentzVector>* constituents, vector<double> radii, JetClustering::Algorithm algorithm, double ptMin) :
+            CollectionBase(name), constituents(constituents), jets(radii.size()) {
+            for (size_t i = 0; i < radii.size(); ++i)
+                clusterings.push_back(JetClustering(radii[i], algorithm, ptMin));
+        }
+
+        // the jets of each radius, in the order the radii were given
+        vector<vector<TLorentzVector>*> Get() {
+            vector<vector<TLorentzVector>*> out;
+            for (size_t i = 0; i < jets.size(); ++i)
+                out.push_back(&jets[i]);
+            return out;
+        }
+
+        void Bind(LeafLayout &) override {}
+
+        void Load() override {
+            for (size_t i = 0; i < clusterings.size(); ++i)
+                jets[i] = clusterings[i].Cluster(*constituents);
+        }
+
+        void Clear() override {
+            for (size_t i = 0; i < jets.size(); ++i)
+                jets[i].clear();
+        }
+
+        void Print(std::ostream & out, const string & prefix) const override {
+            for (size_t i = 0; i < jets.size(); ++i)
+                for (size_t j = 0; j < jets[i].size(); ++j) {
+                    out << prefix << "[" << i << "] ";
+                    Collections::Print(out, jets[i][j]);
+                    out << std::endl;
+                }
+        }
+
+    private:
+        const vector<TLorentzVector>* constituents;
+        vector<JetClustering> clusterings;
+        vector<vector<TLorentzVector>> jets;
+    };
+};
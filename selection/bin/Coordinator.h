@@ -0,0 +1,405 @@
+#pragma once
+#include "SamplePool.h"
+#include "Socket.h"
+#include <poll.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+// distributed running. a coordinator owns the samples and their file lists and hands out work
+// units (files, or entry ranges of files with --chunk) to any number of worker processes, which
+// connect over tcp from this or other hosts. results come back as partials and are merged as they
+// arrive; units held by a worker whose connection drops go back to the front of the queue.
+// workers send a heartbeat with the entries they have read every HEARTBEAT_SECONDS; one which is
+// not heard from for SILENCE_SECONDS (unreachable, frozen), or whose count stays put for
+// STALL_SECONDS while it holds a unit (hung), is dropped as if its connection had.
+//
+// messages (see Socket):
+//   worker -> coordinator:  HELLO <layout>, ALIVE <entries read>, RESULT <partial>, ERROR <message>
+//   coordinator -> worker:  WORK '<first> <last> <file>', REJECT <message>, DONE
+template<typename analysis>
+class Coordinator : public SamplePool<analysis> {
+    typedef SamplePool<analysis> Pool;
+    typedef typename Pool::Task Task;
+
+public:
+    Coordinator(SVJFinder & config) : Pool(config) {}
+
+    void Run() {
+        SVJFinder & config = this->config;
+        TH1::AddDirectory(kFALSE);
+        this->RejectSerialOptions();
+        if (config.stageDir.size() > 0)
+            config.log("WARNING :: --stage is ignored when coordinating; workers read their units from the sources");
+        config.start();
+        this->ReadSamples();
+        this->MakeTasks();
+        this->UseCache();
+        SplitTasks();
+        config.end();
+        config.logt();
+
+        for (size_t i = 0; i < this->tasks.size(); ++i)
+            pending.push_back(i);
+        attempts.assign(this->tasks.size(), 0);
+
+        Socket listener = Socket::Listen(config.coordinatorPort);
+        config.log("Waiting for workers on port " + to_string(config.coordinatorPort) + " to process " + to_string(this->tasks.size()) + " units");
+        config.log();
+
+        config.start();
+        string error;
+        try {
+            Serve(listener);
+        }
+        catch (string & e) {
+            error = e;
+        }
+        for (size_t i = 0; i < workers.size(); ++i) {
+            try {
+                workers[i]->socket.Send("DONE");
+            }
+            catch (string &) {}
+        }
+        workers.clear();
+        config.end();
+        config.logt();
+
+        if (!error.empty())
+            throw error;
+
+        this->WriteOutputs();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Connection {
+        Connection(Socket && s) : socket(std::move(s)), heard(Clock::now()), progressed(heard) {}
+        Socket socket;
+        bool ready = false;
+        long unit = -1;
+        // when the worker was last heard from, and when its count of entries read last moved
+        Clock::time_point heard, progressed;
+        Long64_t entries = -1;
+    };
+
+    // a unit which takes down this many workers fails the whole run instead of the next worker
+    static const int MAX_ATTEMPTS = 3;
+
+    // seconds without any message, and with a unit but no new entries read, before a worker is
+    // dropped; and the longest a message may take to arrive once it has started
+    static constexpr double SILENCE_SECONDS = 60;
+    static constexpr double STALL_SECONDS = 600;
+    static const int MESSAGE_TIMEOUT = 60;
+
+    void Serve(Socket & listener) {
+        SVJFinder & config = this->config;
+        if (this->tasks.empty())
+            return;
+        string layout = this->samples[0].core->Layout();
+        while (finished < this->tasks.size()) {
+            vector<pollfd> fds(1 + workers.size());
+            fds[0].fd = listener.fd;
+            fds[0].events = POLLIN;
+            for (size_t i = 0; i < workers.size(); ++i) {
+                fds[i + 1].fd = workers[i]->socket.fd;
+                fds[i + 1].events = POLLIN;
+            }
+            if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR)
+                throw "poll failed: " + string(strerror(errno));
+
+            // walk backwards, so dropping a worker leaves the remaining indices valid
+            for (size_t i = workers.size(); i-- > 0;) {
+                if (fds[i + 1].revents == 0)
+                    continue;
+                Connection & w = *workers[i];
+                try {
+                    string type, payload;
+                    if (!w.socket.Receive(type, payload))
+                        throw string("connection closed");
+                    w.heard = Clock::now();
+                    if (type == "ALIVE") {
+                        char* end = nullptr;
+                        errno = 0;
+                        Long64_t entries = std::strtoll(payload.c_str(), &end, 10);
+                        if (payload.empty() || *end != '\0' || errno == ERANGE)
+                            throw "malformed ALIVE message '" + payload.substr(0, 32) + "'";
+                        if (entries != w.entries)
+                            w.progressed = w.heard;
+                        w.entries = entries;
+                    }
+                    else if (type == "HELLO") {
+                        if (payload != layout) {
+                            w.socket.Send("REJECT", "worker layout '" + payload + "' does not match '" + layout + "'");
+                            throw "layout mismatch (" + payload + ")";
+                        }
+                        w.ready = true;
+                    }
+                    else if (type == "RESULT" && w.unit >= 0) {
+                        std::stringstream ss(payload);
+                        const Task & t = this->tasks[w.unit];
+                        SVJFinder::Partial p = SVJFinder::Partial::Read(ss);
+                        this->samples[t.sample].core->Merge(p);
+                        if (this->cache)
+                            Cache(t, p);
+                        config.log("Finished unit " + to_string(++finished) + " of " + to_string(this->tasks.size()) + " (" + this->samples[t.sample].core->sample + ")");
+                        w.unit = -1;
+                    }
+                    else if (type == "ERROR" && w.unit >= 0) {
+                        // the selection itself failed; another worker would fail the same way
+                        failure = Describe(this->tasks[w.unit]) + ": " + payload;
+                    }
+                    else {
+                        throw "unexpected message " + type;
+                    }
+                }
+                catch (string & e) {
+                    Drop(i, e);
+                }
+                catch (std::exception & e) {
+                    // e.g. a result too large to read back; only this worker is lost
+                    Drop(i, e.what());
+                }
+            }
+            if (!failure.empty())
+                throw failure;
+            DropSilent();
+
+            if (fds[0].revents & POLLIN) {
+                workers.push_back(std::unique_ptr<Connection>(new Connection(listener.Accept())));
+                workers.back()->socket.Timeout(MESSAGE_TIMEOUT);
+                config.log("Worker connected (" + to_string(workers.size()) + " connected)");
+            }
+
+            Assign();
+        }
+    }
+
+    // drops workers which have gone quiet, or which sit on a unit without reading anything
+    void DropSilent() {
+        Clock::time_point now = Clock::now();
+        for (size_t i = workers.size(); i-- > 0;) {
+            Connection & w = *workers[i];
+            double silent = std::chrono::duration<double>(now - w.heard).count();
+            double stalled = std::chrono::duration<double>(now - w.progressed).count();
+            if (silent > SILENCE_SECONDS)
+                Drop(i, "no heartbeat for " + to_string(int(silent)) + " s");
+            else if (w.unit >= 0 && stalled > STALL_SECONDS)
+                Drop(i, "no entries read for " + to_string(int(stalled)) + " s on " + Describe(this->tasks[w.unit]));
+        }
+    }
+
+    // hands the next pending units to idle workers
+    void Assign() {
+        for (size_t i = 0; i < workers.size() && !pending.empty(); ++i) {
+            Connection & w = *workers[i];
+            if (!w.ready || w.unit >= 0)
+                continue;
+            size_t u = pending.front();
+            const Task & t = this->tasks[u];
+            try {
+                w.socket.Send("WORK", to_string(t.first) + " " + to_string(t.last) + " " + t.filename);
+                w.unit = u;
+                w.progressed = Clock::now();
+                pending.pop_front();
+            }
+            catch (string & e) {
+                Drop(i--, e);
+            }
+        }
+    }
+
+    // keeps the units of a file until all of them are in, and caches their sum in entry order
+    void Cache(const Task & t, const SVJFinder::Partial & p) {
+        chunks[t.file][t.first] = p;
+        if (--chunksLeft[t.file] > 0)
+            return;
+        SVJFinder::Partial whole;
+        for (auto it = chunks[t.file].begin(); it != chunks[t.file].end(); ++it)
+            whole.Add(it->second);
+        chunks[t.file].clear();
+        this->cache->Store(t.filename, whole);
+    }
+
+    // forgets a worker; its unit goes back to the front of the queue
+    void Drop(size_t i, string reason) {
+        Connection & w = *workers[i];
+        this->config.log("Lost worker: " + reason);
+        if (w.unit >= 0) {
+            if (++attempts[w.unit] >= MAX_ATTEMPTS)
+                throw Describe(this->tasks[w.unit]) + ": lost " + to_string(MAX_ATTEMPTS) + " workers";
+            this->config.log("Reassigning " + Describe(this->tasks[w.unit]));
+            pending.push_front(w.unit);
+        }
+        workers.erase(workers.begin() + i);
+    }
+
+    // with --chunk, every file becomes one unit per range of chunkSize entries
+    void SplitTasks() {
+        SVJFinder & config = this->config;
+        chunks.assign(this->tasks.size(), std::map<Long64_t, SVJFinder::Partial>());
+        chunksLeft.assign(this->tasks.size(), 1);
+        for (size_t i = 0; i < this->tasks.size(); ++i)
+            this->tasks[i].file = i;
+        if (config.chunkSize <= 0)
+            return;
+        vector<Task> split;
+        for (size_t i = 0; i < this->tasks.size(); ++i) {
+            chunksLeft[i] = 0;
+            ParallelTreeChain chain;
+            chain.GetTrees(vector<string>(1, this->tasks[i].filename), "Delphes");
+            Long64_t n = chain.GetEntries();
+            Task t = this->tasks[i];
+            for (t.first = 0; t.first + config.chunkSize < n; t.first += config.chunkSize) {
+                t.last = t.first + config.chunkSize;
+                split.push_back(t);
+                chunksLeft[i]++;
+            }
+            // the last range runs to the end of the file
+            t.last = -1;
+            split.push_back(t);
+            chunksLeft[i]++;
+        }
+        config.log("Split " + to_string(this->tasks.size()) + " files into " + to_string(split.size()) + " units of up to " + to_string(config.chunkSize) + " entries");
+        this->tasks.swap(split);
+    }
+
+    static string Describe(const Task & t) {
+        if (t.first == 0 && t.last < 0)
+            return t.filename;
+        return t.filename + " (entries " + to_string(t.first) + "-" + (t.last < 0 ? string("end") : to_string(t.last)) + ")";
+    }
+
+    vector<std::unique_ptr<Connection>> workers;
+    std::deque<size_t> pending;
+    vector<int> attempts;
+    size_t finished = 0;
+
+    // with a cache, the results of the units of each file which are in so far, by first entry,
+    // and the number of units still out
+    vector<std::map<Long64_t, SVJFinder::Partial>> chunks;
+    vector<size_t> chunksLeft;
+    string failure;
+};
+
+// a worker process: runs the units it is handed with its own core, and sends back partials
+template<typename analysis>
+class RemoteWorker {
+public:
+    RemoteWorker(SVJFinder & config) : config(config) {}
+
+    void Run() {
+        TH1::AddDirectory(kFALSE);
+        SVJFinder core(SVJFinder::InheritSettings(), config);
+        analysis selection(core);
+
+        if (config.stageDir.size() > 0)
+            config.log("WARNING :: --stage is not used by remote workers; they read their units from the sources");
+
+        Socket coordinator = ConnectWithRetry();
+        coordinator.Send("HELLO", core.Layout());
+        config.log("Connected to coordinator at " + config.coordinatorAddress);
+        std::mutex sending;
+        Heartbeat heartbeat(coordinator, sending, core.entriesRead);
+
+        string type, payload;
+        size_t done = 0;
+        while (coordinator.Receive(type, payload)) {
+            if (type == "DONE")
+                break;
+            if (type == "REJECT")
+                throw "Coordinator rejected worker: " + payload;
+            if (type != "WORK")
+                throw "Unexpected message " + type;
+
+            std::stringstream unit(payload);
+            Long64_t first, last;
+            string filename;
+            unit >> first >> last >> std::ws;
+            getline(unit, filename);
+            try {
+                core.UseFile(filename);
+                Long64_t end = (last < 0 || last > core.GetEntries()) ? core.GetEntries() : last;
+                core.ProcessRange(selection, first, end);
+                std::stringstream result;
+                core.Export().Write(result);
+                std::lock_guard<std::mutex> lock(sending);
+                coordinator.Send("RESULT", result.str());
+                config.log("Finished unit " + to_string(++done) + " (" + filename + ")");
+            }
+            catch (string & e) {
+                {
+                    std::lock_guard<std::mutex> lock(sending);
+                    coordinator.Send("ERROR", e);
+                }
+                throw filename + ": " + e;
+            }
+        }
+        config.log("Coordinator finished; processed " + to_string(done) + " units");
+    }
+
+private:
+    // sends ALIVE with the entries read so far every HEARTBEAT_SECONDS from its own thread, for as
+    // long as it exists. it only proves the process is alive and reachable; whether it gets
+    // anywhere the coordinator tells from the count
+    class Heartbeat {
+    public:
+        Heartbeat(Socket & socket, std::mutex & sending, const std::atomic<Long64_t> & entries) : socket(socket), sending(sending), entries(entries), thread(&Heartbeat::Beat, this) {}
+
+        ~Heartbeat() {
+            {
+                std::lock_guard<std::mutex> lock(waiting);
+                stopping = true;
+            }
+            wake.notify_all();
+            thread.join();
+        }
+
+    private:
+        void Beat() {
+            std::unique_lock<std::mutex> lock(waiting);
+            while (!wake.wait_for(lock, std::chrono::seconds(HEARTBEAT_SECONDS), [this]() { return stopping; })) {
+                try {
+                    std::lock_guard<std::mutex> send(sending);
+                    socket.Send("ALIVE", to_string(entries.load(std::memory_order_relaxed)));
+                }
+                catch (string &) {
+                    // the connection is gone; the worker finds out on its next receive
+                    return;
+                }
+            }
+        }
+
+        static const int HEARTBEAT_SECONDS = 10;
+
+        Socket & socket;
+        std::mutex & sending;
+        const std::atomic<Long64_t> & entries;
+        std::mutex waiting;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    // workers may well be started before the coordinator is listening
+    Socket ConnectWithRetry() {
+        for (int attempt = 0; ; ++attempt) {
+            try {
+                return Socket::Connect(config.coordinatorAddress);
+            }
+            catch (string & e) {
+                if (attempt >= 30)
+                    throw e;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+        }
+    }
+
+    SVJFinder & config;
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+// follows a source of input file names which grows while the selection runs, so selection can
+// start before production ends. the source is one of
+//  - a list file, read like tail -f: producers append the name of each file once it is closed
+//  - a named pipe, read the same way; writers may come and go
+//  - a directory, polled for new .root files. producers have to write each file under another
+//    name (hidden with a leading '.', or not ending in .root, e.g. 'x.root.part') and rename it
+//    once it is closed: a visible .root file counts as complete as soon as it shows up. renames
+//    within a filesystem are atomic, so no half-written file is ever handed out
+// the stream ends at the marker END_MARKER: a line of a list or pipe, or a file in a directory.
+// every name is handed out once
+class FileStream {
+public:
+    static constexpr const char* END_MARKER = "END";
+
+    FileStream(string source, double poll=1.) : source(source), poll(poll) {
+        struct stat st;
+        if (stat(source.c_str(), &st) != 0)
+            throw "Could not find stream source '" + source + "'";
+        directory = S_ISDIR(st.st_mode);
+    }
+
+    // blocks until the next file is complete and stores its name; false once the stream ended
+    // (or Stop was called) and every file before the marker was handed out
+    bool Next(string & filename) {
+        while (ready.empty() && !ended && !stopped) {
+            if (directory ? !PollDirectory() : !PollList())
+                std::this_thread::sleep_for(std::chrono::milliseconds(long(poll*1000)));
+        }
+        if (ready.empty())
+            return false;
+        filename = ready.front();
+        ready.erase(ready.begin());
+        return true;
+    }
+
+    // ends the stream early, e.g. from a signal handler thread
+    void Stop() {
+        stopped = true;
+    }
+
+    bool Ended() {
+        return ended;
+    }
+
+private:
+    // reads every complete line there is; a line without its newline yet is kept for later.
+    // false if nothing new came in
+    bool PollList() {
+        if (!list.is_open()) {
+            list.open(source.c_str());
+            if (!list.is_open())
+                throw "Could not open stream source '" + source + "'";
+        }
+        bool read = false;
+        string line;
+        while (!ended && getline(list, line)) {
+            if (list.eof()) {
+                pending += line;
+                break;
+            }
+            read = true;
+            line = pending + line;
+            pending.clear();
+            if (line == END_MARKER)
+                ended = true;
+            else if (line.size() > 0 && line[0] != '#')
+                Add(line);
+        }
+        // at the end of the data: clear eof, so the next poll picks up what was appended
+        list.clear();
+        return read;
+    }
+
+    // queues the new visible .root files, in name order. the marker is looked for before the
+    // files, so every file renamed into place before it was written is picked up
+    bool PollDirectory() {
+        DIR* d = opendir(source.c_str());
+        if (d == nullptr)
+            throw "Could not read stream directory '" + source + "'";
+        vector<string> names;
+        for (struct dirent* e = readdir(d); e != nullptr; e = readdir(d))
+            names.push_back(e->d_name);
+        closedir(d);
+        bool marker = std::find(names.begin(), names.end(), string(END_MARKER)) != names.end();
+        if (marker) {
+            // a file renamed in after the listing above and before the marker was created
+            d = opendir(source.c_str());
+            if (d == nullptr)
+                throw "Could not read stream directory '" + source + "'";
+            names.clear();
+            for (struct dirent* e = readdir(d); e != nullptr; e = readdir(d))
+                names.push_back(e->d_name);
+            closedir(d);
+        }
+        vector<string> complete;
+        for (size_t i = 0; i < names.size(); ++i) {
+            const string & name = names[i];
+            if (name.empty() || name[0] == '.' || name.size() < 5 || name.compare(name.size() - 5, 5, ".root") != 0)
+                continue;
+            string path = source + "/" + name;
+            if (!seen.count(path))
+                complete.push_back(path);
+        }
+        std::sort(complete.begin(), complete.end());
+        for (size_t i = 0; i < complete.size(); ++i)
+            Add(complete[i]);
+        if (marker)
+            ended = true;
+        return complete.size() > 0;
+    }
+
+    void Add(const string & filename) {
+        if (seen.insert(filename).second)
+            ready.push_back(filename);
+    }
+
+    string source;
+    double poll;
+    bool directory = false;
+    bool ended = false;
+    std::atomic<bool> stopped{false};
+
+    std::ifstream list;
+    string pending;
+
+    std::set<string> seen;
+    vector<string> ready;
+};
@@ -0,0 +1,296 @@
+#pragma once
+#include "TLorentzVector.h"
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+using std::string;
+using std::vector;
+
+// sequential recombination jet clustering: anti-kt, kt and Cambridge/Aachen, with E-scheme
+// recombination. the closest pair under d_ij = min(kt_i^2p, kt_j^2p) dR_ij^2 / R^2 is always a
+// pair of geometric nearest neighbours, so every pseudojet only tracks its nearest neighbour
+// within R. pseudojets sit in tiles of (rapidity, phi) at least R wide, so that neighbour is
+// in the same or one of the 8 surrounding tiles, and a merge only touches the pseudojets in the
+// tiles around it. the smallest distance comes from a min-heap; entries of pseudojets which have
+// changed since they were pushed are skipped when they come up. events cluster in about N log N
+class JetClustering {
+public:
+    enum Algorithm {
+        antikt,
+        kt,
+        cambridge
+    };
+
+    // 'antikt', 'kt' or 'ca'
+    static Algorithm FromName(const string & name) {
+        if (name == "antikt" || name == "ak")
+            return antikt;
+        if (name == "kt")
+            return kt;
+        if (name == "ca" || name == "cambridge")
+            return cambridge;
+        throw "Unknown jet algorithm '" + name + "'";
+    }
+
+    // short name for output names, e.g. ak08 for anti-kt with R = 0.8
+    static string ShortName(Algorithm algorithm, double R) {
+        const char* names[] = {"ak", "kt", "ca"};
+        int r = int(std::round(R*10));
+        return string(names[algorithm]) + (r < 10 ? "0" : "") + std::to_string(r);
+    }
+
+    JetClustering(double R, Algorithm algorithm=antikt, double ptMin=0.) : R(R), R2(R*R), algorithm(algorithm), ptMin(ptMin) {
+        if (R <= 0)
+            throw string("Jet radius has to be positive");
+    }
+
+    // clusters the particles, and returns the jets above ptMin by decreasing pt
+    vector<TLorentzVector> Cluster(const vector<TLorentzVector> & particles) {
+        Init(particles);
+        vector<TLorentzVector> jets;
+        while (active > 0) {
+            Entry top = heap.top();
+            heap.pop();
+            int i = top.index;
+            if (!jets_[i].active || top.version != jets_[i].version)
+                continue;
+
+            int j = jets_[i].nn;
+            if (j < 0) {
+                // closer to the beam than to anything else: a final jet
+                TLorentzVector jet;
+                jet.SetPxPyPzE(jets_[i].px, jets_[i].py, jets_[i].pz, jets_[i].E);
+                if (jet.Pt() >= ptMin)
+                    jets.push_back(jet);
+                Remove(i);
+                Update(vector<int>(1, i), -1);
+            }
+            else {
+                int k = Merge(i, j);
+                Update(vector<int>{i, j}, k);
+            }
+        }
+        std::sort(jets.begin(), jets.end(), [](const TLorentzVector & a, const TLorentzVector & b) { return a.Pt() > b.Pt(); });
+        return jets;
+    }
+
+private:
+    struct PseudoJet {
+        double px, py, pz, E;
+        double rap, phi;
+        // kt^2p of the algorithm
+        double mom;
+        int tile;
+        // nearest neighbour within R, or -1, and the squared distance to it (R^2 without one)
+        int nn;
+        double nnDist;
+        int version;
+        bool active;
+    };
+
+    // heap entries; a pseudojet's entry is stale once its version has moved on
+    struct Entry {
+        double d;
+        int index;
+        int version;
+        bool operator>(const Entry & other) const {
+            return d > other.d;
+        }
+    };
+
+    void Init(const vector<TLorentzVector> & particles) {
+        jets_.clear();
+        heap = std::priority_queue<Entry, vector<Entry>, std::greater<Entry>>();
+        active = 0;
+
+        // tiles at least R wide in both directions; rapidities beyond +-MAX_RAP share the edge
+        // tiles, which keeps neighbours within one tile of each other
+        const double limit = MAX_RAP;
+        double low = limit, high = -limit;
+        for (size_t i = 0; i < particles.size(); ++i) {
+            Add(particles[i].Px(), particles[i].Py(), particles[i].Pz(), particles[i].E());
+            low = std::min(low, jets_.back().rap);
+            high = std::max(high, jets_.back().rap);
+        }
+        rapMin = std::max(low, -limit);
+        // fewer than 3 phi tiles for large R: the neighbourhood then wraps onto itself, which
+        // Neighbourhood folds back to the distinct tiles
+        nPhi = std::max(1, int(2*M_PI/R));
+        nRap = std::max(1, int((std::min(high, limit) - rapMin)/R) + 1);
+        tiles.assign(nRap*nPhi, vector<int>());
+
+        for (size_t i = 0; i < jets_.size(); ++i)
+            Insert(i);
+        for (size_t i = 0; i < jets_.size(); ++i) {
+            FindNN(i);
+            Push(i);
+        }
+    }
+
+    // a new pseudojet, not yet in a tile
+    int Add(double px, double py, double pz, double E) {
+        PseudoJet p;
+        p.px = px;
+        p.py = py;
+        p.pz = pz;
+        p.E = E;
+        double pt2 = px*px + py*py;
+        p.phi = (pt2 > 0) ? std::atan2(py, px) : 0;
+        if (p.phi < 0)
+            p.phi += 2*M_PI;
+        if (E > std::fabs(pz))
+            p.rap = 0.5*std::log((E + pz)/(E - pz));
+        else
+            p.rap = pz >= 0 ? 2*MAX_RAP : -2*MAX_RAP;
+        if (algorithm == antikt)
+            p.mom = pt2 > 0 ? 1./pt2 : 1e300;
+        else if (algorithm == kt)
+            p.mom = pt2;
+        else
+            p.mom = 1.;
+        p.tile = -1;
+        p.nn = -1;
+        p.nnDist = R2;
+        p.version = 0;
+        p.active = true;
+        jets_.push_back(p);
+        active++;
+        return jets_.size() - 1;
+    }
+
+    int TileOf(const PseudoJet & p) {
+        int r = int((p.rap - rapMin)/R);
+        r = std::min(std::max(r, 0), nRap - 1);
+        int f = std::min(int(p.phi/(2*M_PI)*nPhi), nPhi - 1);
+        return r*nPhi + f;
+    }
+
+    // the tile and its (up to) 8 neighbours; phi wraps around, rapidity does not
+    vector<int> Neighbourhood(int tile) {
+        vector<int> out;
+        int r = tile / nPhi, f = tile % nPhi;
+        for (int dr = -1; dr <= 1; ++dr) {
+            if (r + dr < 0 || r + dr >= nRap)
+                continue;
+            for (int df = -1; df <= 1; ++df)
+                out.push_back((r + dr)*nPhi + (f + df + nPhi) % nPhi);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+
+    void Insert(int i) {
+        jets_[i].tile = TileOf(jets_[i]);
+        tiles[jets_[i].tile].push_back(i);
+    }
+
+    void Remove(int i) {
+        vector<int> & tile = tiles[jets_[i].tile];
+        tile.erase(std::find(tile.begin(), tile.end(), i));
+        jets_[i].active = false;
+        active--;
+    }
+
+    double Distance(const PseudoJet & a, const PseudoJet & b) {
+        double dphi = std::fabs(a.phi - b.phi);
+        if (dphi > M_PI)
+            dphi = 2*M_PI - dphi;
+        double drap = a.rap - b.rap;
+        return drap*drap + dphi*dphi;
+    }
+
+    void FindNN(int i) {
+        PseudoJet & p = jets_[i];
+        p.nn = -1;
+        p.nnDist = R2;
+        vector<int> around = Neighbourhood(p.tile);
+        for (size_t t = 0; t < around.size(); ++t) {
+            const vector<int> & tile = tiles[around[t]];
+            for (size_t n = 0; n < tile.size(); ++n) {
+                if (tile[n] == i)
+                    continue;
+                double d = Distance(p, jets_[tile[n]]);
+                if (d < p.nnDist) {
+                    p.nnDist = d;
+                    p.nn = tile[n];
+                }
+            }
+        }
+    }
+
+    // d_ij with the nearest neighbour, or d_iB without one, in units of R^2
+    void Push(int i) {
+        PseudoJet & p = jets_[i];
+        p.version++;
+        double mom = p.nn >= 0 ? std::min(p.mom, jets_[p.nn].mom) : p.mom;
+        heap.push(Entry{p.nnDist*mom/R2, i, p.version});
+    }
+
+    int Merge(int i, int j) {
+        Remove(i);
+        Remove(j);
+        int k = Add(jets_[i].px + jets_[j].px, jets_[i].py + jets_[j].py, jets_[i].pz + jets_[j].pz, jets_[i].E + jets_[j].E);
+        Insert(k);
+        return k;
+    }
+
+    // after removing the pseudojets gone (and adding k, if >= 0): pseudojets which had one of them
+    // as nearest neighbour look again, and those near k check whether k is nearer
+    void Update(const vector<int> & gone, int k) {
+        vector<int> around;
+        for (size_t g = 0; g < gone.size(); ++g) {
+            vector<int> n = Neighbourhood(jets_[gone[g]].tile);
+            around.insert(around.end(), n.begin(), n.end());
+        }
+        if (k >= 0) {
+            vector<int> n = Neighbourhood(jets_[k].tile);
+            around.insert(around.end(), n.begin(), n.end());
+        }
+        std::sort(around.begin(), around.end());
+        around.erase(std::unique(around.begin(), around.end()), around.end());
+
+        for (size_t t = 0; t < around.size(); ++t) {
+            const vector<int> & tile = tiles[around[t]];
+            for (size_t n = 0; n < tile.size(); ++n) {
+                int m = tile[n];
+                if (m == k)
+                    continue;
+                PseudoJet & p = jets_[m];
+                if (std::find(gone.begin(), gone.end(), p.nn) != gone.end()) {
+                    FindNN(m);
+                    Push(m);
+                }
+                else if (k >= 0) {
+                    double d = Distance(p, jets_[k]);
+                    if (d < p.nnDist) {
+                        p.nnDist = d;
+                        p.nn = k;
+                        Push(m);
+                    }
+                }
+            }
+        }
+        if (k >= 0) {
+            FindNN(k);
+            Push(k);
+        }
+    }
+
+    static constexpr double MAX_RAP = 10.;
+
+    double R, R2;
+    Algorithm algorithm;
+    double ptMin;
+
+    vector<PseudoJet> jets_;
+    std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> heap;
+    vector<vector<int>> tiles;
+    int nRap = 1, nPhi = 3;
+    double rapMin = 0;
+    int active = 0;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "TTree.h"
+#include "TLeaf.h"
+#include "TObjArray.h"
+#include <string>
+#include <map>
+
+using std::string;
+
+// resolves leaves by name once per tree schema instead of once per tree. a schema is
+// fingerprinted from the name, type, static length and counter of every leaf, in order, so trees
+// with the same fingerprint hold the same leaves at the same positions of their leaf lists: a
+// leaf searched for by name in the first tree of a schema is picked by position in every later
+// one. trees with a schema not seen before fall back to searching by name, once per leaf
+class LeafLayout {
+public:
+    // one pass over the leaves of a tree, 64 bit FNV-1a
+    static unsigned long long Fingerprint(TTree* tree) {
+        unsigned long long h = 14695981039346656037ULL;
+        TObjArray* leaves = tree->GetListOfLeaves();
+        for (int i = 0; leaves != nullptr && i < leaves->GetEntriesFast(); ++i) {
+            TLeaf* leaf = (TLeaf*)leaves->UncheckedAt(i);
+            TLeaf* count = leaf->GetLeafCount();
+            string entry = string(leaf->GetName()) + ":" + leaf->GetTypeName() + ":" + std::to_string(leaf->GetLenStatic()) + ":" + (count ? count->GetName() : "") + ";";
+            for (size_t j = 0; j < entry.size(); ++j) {
+                h ^= (unsigned char)entry[j];
+                h *= 1099511628211ULL;
+            }
+        }
+        return h;
+    }
+
+    // makes Find resolve leaves in tree, whose schema has the given fingerprint
+    void Use(TTree* tree, unsigned long long fingerprint) {
+        current = tree;
+        positions = &schemas[fingerprint];
+    }
+
+    // the leaf of the given name in the current tree, or nullptr
+    TLeaf* Find(const string & name) {
+        auto it = positions->find(name);
+        if (it != positions->end())
+            return it->second < 0 ? nullptr : (TLeaf*)current->GetListOfLeaves()->UncheckedAt(it->second);
+        searches++;
+        TLeaf* leaf = current->FindLeaf(name.c_str());
+        int position = leaf ? current->GetListOfLeaves()->IndexOf(leaf) : -1;
+        // leaves found outside the leaf list (e.g. in friend trees) are searched for every time
+        if (leaf == nullptr || position >= 0)
+            (*positions)[name] = position;
+        return leaf;
+    }
+
+    // distinct schemas seen, and searches by name done, so far
+    size_t Schemas() {
+        return schemas.size();
+    }
+
+    size_t Searches() {
+        return searches;
+    }
+
+private:
+    TTree* current = nullptr;
+    // position of each leaf name in the leaf list, per fingerprint; -1 for missing leaves
+    std::map<unsigned long long, std::map<string, int>> schemas;
+    std::map<string, int>* positions = nullptr;
+    size_t searches = 0;
+};
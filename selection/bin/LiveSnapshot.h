@@ -0,0 +1,138 @@
+#pragma once
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+
+using std::string;
+using std::vector;
+
+// a snapshot of a running selection in a shared memory segment (a file mapped by the writer and
+// any number of readers, normally under /dev/shm), so its cutflow and histograms can be looked at
+// while it runs (see selection/liveview.py). the writer never waits for readers: it bumps the
+// sequence number to odd, rewrites the data and bumps it back to even. a reader copies the
+// data and keeps the copy if the sequence was even and unchanged around it, or tries again.
+//
+// layout, little endian, everything 8 bytes wide:
+//   Header
+//   names: text, one line per variation ('variation <name>'), cut ('cut <name>') and histogram
+//          ('hist <name> <bins> <min> <max>'), in the order of the data
+//   data:  per variation, the cutflow (cuts + 1 int64, no selection first), then the bins of
+//          every histogram (bins + 2 doubles each, underflow and overflow included)
+class LiveSnapshot {
+public:
+    struct Header {
+        char magic[8];
+        std::atomic<uint64_t> sequence;
+        uint64_t version;
+        uint64_t variations, cuts, hists, bins;
+        uint64_t namesOffset, namesSize, dataOffset, size;
+        // entries to run and run so far, and whether the run is over
+        uint64_t entries, done, finished;
+        // unix time of the start and of this snapshot, and entries per second since the last one
+        double startTime, updateTime, rate;
+    };
+    static_assert(sizeof(Header) == 136, "live snapshot header has to match its readers");
+
+    struct Hist {
+        string name;
+        int bins;
+        double min, max;
+    };
+
+    LiveSnapshot(const string & path, const vector<string> & variations, const vector<string> & cuts, const vector<Hist> & hists) : path(path) {
+        std::stringstream names;
+        names << std::setprecision(17);
+        for (size_t v = 0; v < variations.size(); ++v)
+            names << "variation " << variations[v] << "\n";
+        for (size_t c = 0; c < cuts.size(); ++c)
+            names << "cut " << cuts[c] << "\n";
+        uint64_t bins = 0;
+        for (size_t h = 0; h < hists.size(); ++h) {
+            names << "hist " << hists[h].name << " " << hists[h].bins << " " << hists[h].min << " " << hists[h].max << "\n";
+            bins += hists[h].bins + 2;
+        }
+        string text = names.str();
+
+        perVariation = cuts.size() + 1 + bins;
+        uint64_t namesOffset = sizeof(Header);
+        uint64_t dataOffset = namesOffset + (text.size() + 7)/8*8;
+        size = dataOffset + 8*perVariation*variations.size();
+
+        // a new file every run, so readers of an earlier one never see this one's data as theirs
+        unlink(path.c_str());
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+            throw "Could not create live snapshot '" + path + "'";
+        if (ftruncate(fd, size) != 0) {
+            close(fd);
+            throw "Could not size live snapshot '" + path + "'";
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            throw "Could not map live snapshot '" + path + "'";
+        memory = static_cast<char*>(mapped);
+
+        header = new (memory) Header();
+        header->sequence.store(1, std::memory_order_relaxed);
+        memcpy(header->magic, "SVJLIVE", 8);
+        header->version = VERSION;
+        header->variations = variations.size();
+        header->cuts = cuts.size();
+        header->hists = hists.size();
+        header->bins = bins;
+        header->namesOffset = namesOffset;
+        header->namesSize = text.size();
+        header->dataOffset = dataOffset;
+        header->size = size;
+        memcpy(memory + namesOffset, text.data(), text.size());
+        header->sequence.store(2, std::memory_order_release);
+    }
+
+    ~LiveSnapshot() {
+        munmap(memory, size);
+    }
+
+    // starts an update; readers retry until End
+    void Begin() {
+        uint64_t s = header->sequence.load(std::memory_order_relaxed);
+        header->sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void End() {
+        header->sequence.store(header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    Header & Info() {
+        return *header;
+    }
+
+    int64_t* CutFlow(size_t v) {
+        return reinterpret_cast<int64_t*>(memory + header->dataOffset) + v*perVariation;
+    }
+
+    // the bins of every histogram of variation v, one after another
+    double* Bins(size_t v) {
+        return reinterpret_cast<double*>(CutFlow(v) + header->cuts + 1);
+    }
+
+    const string path;
+
+private:
+    static const uint64_t VERSION = 1;
+
+    char* memory = nullptr;
+    Header* header = nullptr;
+    uint64_t perVariation = 0;
+    uint64_t size = 0;
+};
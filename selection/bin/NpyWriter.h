@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <type_traits>
+
+using std::string;
+using std::vector;
+
+// streams a column of numbers (doubles by default) into a one-dimensional .npy file of the
+// matching dtype. the header is written up front, padded to a fixed size which fits any row count,
+// and rewritten with the final shape on Close; the data never moves, so the result can be opened
+// with np.load(path, mmap_mode='r'). rows are buffered and written in blocks
+template<typename T=double>
+class NpyWriter {
+    static_assert(std::is_arithmetic<T>::value, "npy columns hold plain numbers");
+
+public:
+    NpyWriter(const string & path) : path(path), out(path.c_str(), std::ios::binary | std::ios::trunc) {
+        if (!out.is_open())
+            throw "Could not open '" + path + "' for writing";
+        WriteHeader(0);
+    }
+
+    ~NpyWriter() {
+        try {
+            Close();
+        }
+        catch (string &) {}
+    }
+
+    void Append(T value) {
+        buffer.push_back(value);
+        if (buffer.size() >= BLOCK_ROWS)
+            Flush();
+    }
+
+    size_t Rows() {
+        return rows + buffer.size();
+    }
+
+    // writes the remaining rows and the final shape
+    void Close() {
+        if (!out.is_open())
+            return;
+        Flush();
+        out.seekp(0);
+        WriteHeader(rows);
+        out.close();
+        if (!out)
+            throw "Could not write '" + path + "'";
+    }
+
+private:
+    // magic, version 1.0 and header length, then the header dict padded with spaces to a multiple
+    // of 64 bytes (npy format 1.0). 128 bytes leave room for any 64 bit row count
+    void WriteHeader(size_t n) {
+        string dict = "{'descr': '" + Descr() + "', 'fortran_order': False, 'shape': (" + std::to_string(n) + ",), }";
+        size_t length = HEADER_SIZE - 10;
+        dict.resize(length - 1, ' ');
+        dict += '\n';
+        out.write("\x93NUMPY\x01\x00", 8);
+        char size[2] = {char(length & 0xff), char(length >> 8)};
+        out.write(size, 2);
+        out.write(dict.data(), dict.size());
+    }
+
+    // the numpy type string of T, e.g. '<f8' or '<i8'; the data is written in host order, and
+    // the selection only runs on little endian machines
+    static string Descr() {
+        char kind = std::is_floating_point<T>::value ? 'f' : std::is_signed<T>::value ? 'i' : 'u';
+        return string("<") + kind + std::to_string(sizeof(T));
+    }
+
+    void Flush() {
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size()*sizeof(T));
+        rows += buffer.size();
+        buffer.clear();
+    }
+
+    static const size_t HEADER_SIZE = 128;
+    static const size_t BLOCK_ROWS = 1 << 16;
+
+    string path;
+    std::ofstream out;
+    vector<T> buffer;
+    size_t rows = 0;
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <sched.h>
+#include <dirent.h>
+
+using std::string;
+using std::vector;
+
+// the NUMA nodes of the machine and the cpus of each which this process may run on, read from
+// /sys/devices/system/node. machines (or containers) without that information, or whose allowed
+// cpus all sit on one node, look like a single node holding every allowed cpu
+class NumaTopology {
+public:
+    NumaTopology() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return;
+
+        DIR* d = opendir(NODE_DIR);
+        for (struct dirent* e = d ? readdir(d) : nullptr; e != nullptr; e = readdir(d)) {
+            string name = e->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != string::npos)
+                continue;
+            vector<int> node(1, std::stoi(name.substr(4)));
+            vector<int> listed = ParseList(string(NODE_DIR) + "/" + name + "/cpulist");
+            for (size_t i = 0; i < listed.size(); ++i)
+                if (listed[i] < CPU_SETSIZE && CPU_ISSET(listed[i], &allowed))
+                    node.push_back(listed[i]);
+            if (node.size() > 1)
+                nodes.push_back(node);
+        }
+        if (d)
+            closedir(d);
+        // in node order, without the node numbers in front
+        std::sort(nodes.begin(), nodes.end());
+        for (size_t i = 0; i < nodes.size(); ++i)
+            nodes[i].erase(nodes[i].begin());
+
+        if (nodes.empty()) {
+            nodes.push_back(vector<int>());
+            for (int c = 0; c < CPU_SETSIZE; ++c)
+                if (CPU_ISSET(c, &allowed))
+                    nodes.back().push_back(c);
+        }
+    }
+
+    size_t Nodes() const {
+        return nodes.size();
+    }
+
+    const vector<int> & Cpus(size_t node) const {
+        return nodes[node];
+    }
+
+    // restricts the calling thread to the cpus of a node, so the memory it touches first is
+    // allocated there. false if the node has no cpus or the kernel refused
+    bool Pin(size_t node) const {
+        if (node >= nodes.size() || nodes[node].empty())
+            return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < nodes[node].size(); ++i)
+            CPU_SET(nodes[node][i], &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+private:
+    static constexpr const char* NODE_DIR = "/sys/devices/system/node";
+
+    // kernel cpu lists, e.g. '0-15,32-47'
+    static vector<int> ParseList(const string & path) {
+        vector<int> cpus;
+        std::ifstream f(path.c_str());
+        string range;
+        while (getline(f, range, ',')) {
+            int first, last;
+            char dash;
+            std::stringstream ss(range);
+            if (!(ss >> first))
+                continue;
+            last = (ss >> dash >> last) ? last : first;
+            for (int c = first; c <= last; ++c)
+                cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    vector<vector<int>> nodes;
+};
@@ -1,6 +1,9 @@
+#pragma once
 #include "TTree.h"
 #include "TLeaf.h"
 #include "TFile.h"
+#include "StagingCache.h"
+#include "LeafLayout.h"
 #include <string>
 #include <iostream>
 #include <fstream> 
@@ -24,6 +27,10 @@ class ParallelTreeChain{
                 files[i] = nullptr; 
             }
 
+            for (size_t i = 0; staging && i < ntrees; ++i)
+                if (acquired[i])
+                    staging->Release(cleanTreenames[i]);
+
             for (size_t i = 0; i < trees.size(); ++i) {
                 trees[i] = nullptr; 
             }
@@ -33,18 +40,27 @@ class ParallelTreeChain{
             return FindLeaf(spec.c_str()); 
         }
 
+        // the leaf in every tree; trees sharing a schema are searched once between them
         vector<TLeaf*> FindLeaf(const char* spec) {
             vector<TLeaf*> v;
             for (size_t i = 0; i < ntrees; ++i) {
-                if (!Contains(spec)) {
-                    cout << "WARNING:: TREE DOES NOT CONTAIN SPEC " << spec << endl;
-                    cout << "WARNING:: ALL POINTERS WILL BE NULL" << endl;  
-                }
-                v.push_back(trees[i]->FindLeaf(spec));
+                layout.Use(trees[i], Fingerprint(i));
+                v.push_back(layout.Find(spec));
+                if (v.back() == nullptr)
+                    cout << "WARNING:: TREE " << i << " DOES NOT CONTAIN SPEC " << spec << endl;
             }
             return v;
         }
 
+        // fingerprint of the leaf schema of tree i (see LeafLayout), computed on first use
+        unsigned long long Fingerprint(size_t i) {
+            if (!fingerprinted[i]) {
+                fingerprints[i] = LeafLayout::Fingerprint(trees[i]);
+                fingerprinted[i] = true;
+            }
+            return fingerprints[i];
+        }
+
         void GetN(int entry){
             int tn = 0;
             while (entry >= 0)
@@ -61,21 +77,96 @@ class ParallelTreeChain{
             if (entry > entries)
                 return -1;
             GetN(entry);
+            Acquire(currentTree);
             trees[currentTree]->GetEntry(currentEntry);
             return currentTree;
         }
 
+        // moves to an entry without reading any branch; readers get the branches they need
+        // themselves, with TBranch::GetEntry(currentEntry)
+        int Seek(int entry) {
+            if (entry > entries)
+                return -1;
+            GetN(entry);
+            Acquire(currentTree);
+            trees[currentTree]->LoadTree(currentEntry);
+            return currentTree;
+        }
+
         Int_t GetEntries() {
             return entries; 
         }
 
+        TTree* GetTree(size_t i) {
+            return trees[i];
+        }
+
         vector<string> GetTrees(string filename, string treetype) {
             GetTreeNames(filename);
+            return OpenTrees(treetype);
+        }
+
+        vector<string> GetTrees(const vector<string> & filenames, string treetype) {
+            treenames = filenames;
+            return OpenTrees(treetype);
+        }
+
+        // opens staged local copies of the inputs where available; set before GetTrees. the
+        // sources are opened for their entry counts, and a tree is switched to its staged copy
+        // when the chain first moves to it, so staging has until then to copy it
+        void SetStaging(StagingCache* cache) {
+            staging = cache;
+        }
+
+        bool Contains(string spec) {
+            // loop through trees and make sure that the spec is contained either the leaf/branch lists of eaech tree
+            for (size_t i = 0; i < trees.size(); ++i) {
+                if (!(trees[i]->GetListOfBranches()->Contains(spec.c_str()) || trees[i]->GetListOfLeaves()->Contains(spec.c_str()))) {
+                    return false;
+                }
+            }
+            return true; 
+        }
+
+        int currentEntry, currentTree;
+
+    private:
+    
+        // reopens tree i from its staged copy, if there is one, the first time it is used.
+        // readers rebind their leaves whenever the chain moves to another tree
+        void Acquire(size_t i) {
+            if (!staging || acquired[i])
+                return;
+            acquired[i] = true;
+            string path = staging->Acquire(cleanTreenames[i]);
+            if (path == cleanTreenames[i])
+                return;
+            TFile* local = new TFile(path.c_str());
+            TTree* tree = local->IsZombie() ? nullptr : (TTree*)local->Get(treetype.c_str());
+            if (tree == nullptr || tree->GetEntries() != (Long64_t)sizes[i]) {
+                local->Close();
+                delete local;
+                return;
+            }
+            files[i]->Close();
+            delete files[i];
+            files[i] = local;
+            trees[i] = tree;
+        }
+
+        vector<string> OpenTrees(string treetype) {
+            this->treetype = treetype;
             entries = 0;
             int i = 0;
-            vector<string> cleanTreenames; 
+            cleanTreenames.clear();
             for (size_t tn = 0; tn < treenames.size(); ++tn) {
                 files.push_back(new TFile(treenames[tn].c_str()));
+                if (files[i]->IsZombie()) {
+                    cout << "WARNING:: COULD NOT OPEN " << treenames[tn] << endl;
+                    delete files[i];
+                    files.pop_back();
+                    continue;
+                }
                 bool hasDelphes = files[i]->GetListOfKeys()->Contains(treetype.c_str());
                 if(hasDelphes) {
                     trees.push_back((TTree*)files[i]->Get(treetype.c_str()));
@@ -90,23 +181,12 @@ class ParallelTreeChain{
                 }
             }   
             ntrees = trees.size();
+            acquired.assign(ntrees, false);
+            fingerprints.assign(ntrees, 0);
+            fingerprinted.assign(ntrees, false);
             return cleanTreenames; 
         }
 
-        bool Contains(string spec) {
-            // loop through trees and make sure that the spec is contained either the leaf/branch lists of eaech tree
-            for (size_t i = 0; i < trees.size(); ++i) {
-                if (!(trees[i]->GetListOfBranches()->Contains(spec.c_str()) || trees[i]->GetListOfLeaves()->Contains(spec.c_str()))) {
-                    return false;
-                }
-            }
-            return true; 
-        }
-
-        int currentEntry, currentTree;
-
-    private:
-    
         void GetTreeNames(string filename) {
             std::ifstream file(filename.c_str());
             string s;
@@ -115,10 +195,18 @@ class ParallelTreeChain{
                     treenames.push_back(s);
         }
 
-        size_t ntrees;
+        size_t ntrees = 0;
         Int_t entries; 
         vector<string> treenames;
+        // the inputs which have a tree, in tree order
+        vector<string> cleanTreenames;
+        string treetype;
         vector<TTree*> trees;
         vector<TFile*> files;
         vector<size_t> sizes; 
+        StagingCache* staging = nullptr;
+        vector<bool> acquired;
+        vector<unsigned long long> fingerprints;
+        vector<bool> fingerprinted;
+        LeafLayout layout;
 }; 
@@ -0,0 +1,236 @@
+#pragma once
+#include "TVectorD.h"
+#include "TH1D.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+using std::string;
+using std::vector;
+
+// a mergeable streaming quantile sketch (KLL). values are kept in a stack of compactors: level h
+// holds values of weight 2^h, and a full level is sorted and every other value is promoted to the
+// level above. level capacities shrink geometrically going down the stack, so the sketch holds
+// O(k) values whatever the number of inputs, and ranks are known to about 1.7/k of the total
+// weight. sketches with the same k merge by appending levels, so results of shards and threads
+// combine exactly as if one sketch had seen all values. weights always sum to the number of
+// values added. usable from PyROOT through gInterpreter.Declare, e.g. to read the TVectorD written
+// by SVJFinder::WriteSketches back with FromVector
+class QuantileSketch {
+public:
+    explicit QuantileSketch(int k=200) : k(std::max(k, 8)) {
+        Reset();
+    }
+
+    void Add(double value) {
+        if (n == 0 || value < low)
+            low = value;
+        if (n == 0 || value > high)
+            high = value;
+        n++;
+        levels[0].push_back(value);
+        if (++stored >= capacity)
+            Compress();
+    }
+
+    // adds all values seen by another sketch with the same k
+    void Merge(const QuantileSketch & other) {
+        if (other.n == 0)
+            return;
+        if (other.k != k)
+            throw "Cannot merge quantile sketches with k=" + std::to_string(k) + " and k=" + std::to_string(other.k);
+        if (n == 0 || other.low < low)
+            low = other.low;
+        if (n == 0 || other.high > high)
+            high = other.high;
+        n += other.n;
+        if (levels.size() < other.levels.size())
+            levels.resize(other.levels.size());
+        for (size_t h = 0; h < other.levels.size(); ++h)
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        stored += other.stored;
+        UpdateCapacity();
+        Compress();
+    }
+
+    void Reset() {
+        levels.assign(1, vector<double>());
+        n = 0;
+        low = high = 0;
+        stored = 0;
+        UpdateCapacity();
+    }
+
+    long long Count() const {
+        return n;
+    }
+
+    double Min() const {
+        return low;
+    }
+
+    double Max() const {
+        return high;
+    }
+
+    // the value at fraction q of the distribution; the exact extremes at q = 0 and 1
+    double Quantile(double q) const {
+        if (n == 0)
+            return 0;
+        if (q <= 0)
+            return low;
+        if (q >= 1)
+            return high;
+        vector<Item> items = Items();
+        double target = q*n, sum = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            sum += items[i].second;
+            if (sum >= target)
+                return items[i].first;
+        }
+        return high;
+    }
+
+    // fraction of the values at or below value
+    double Rank(double value) const {
+        if (n == 0)
+            return 0;
+        double sum = 0;
+        for (size_t h = 0; h < levels.size(); ++h)
+            for (size_t i = 0; i < levels[h].size(); ++i)
+                if (levels[h][i] <= value)
+                    sum += std::ldexp(1., h);
+        return sum/n;
+    }
+
+    // a histogram of the sketched distribution in any binning, normalized to the number of values
+    TH1D* Histogram(string name, string title, int bins, double min, double max) const {
+        TH1D* h = new TH1D(name.c_str(), title.c_str(), bins, min, max);
+        h->SetDirectory(0);
+        for (size_t l = 0; l < levels.size(); ++l)
+            for (size_t i = 0; i < levels[l].size(); ++i)
+                h->Fill(levels[l][i], std::ldexp(1., l));
+        h->SetEntries(n);
+        return h;
+    }
+
+    // flat form: k, count, min, max, number of levels, then the size and values of each level
+    vector<double> ToVector() const {
+        vector<double> out = {double(k), double(n), low, high, double(levels.size())};
+        for (size_t h = 0; h < levels.size(); ++h) {
+            out.push_back(levels[h].size());
+            out.insert(out.end(), levels[h].begin(), levels[h].end());
+        }
+        return out;
+    }
+
+    static QuantileSketch FromVector(const vector<double> & in) {
+        if (in.size() < 5)
+            throw string("Malformed quantile sketch");
+        QuantileSketch s((int)in[0]);
+        s.n = (long long)in[1];
+        s.low = in[2];
+        s.high = in[3];
+        s.levels.resize(size_t(in[4]));
+        size_t pos = 5;
+        for (size_t h = 0; h < s.levels.size(); ++h) {
+            if (pos >= in.size() || pos + 1 + size_t(in[pos]) > in.size())
+                throw string("Malformed quantile sketch");
+            s.levels[h].assign(in.begin() + pos + 1, in.begin() + pos + 1 + size_t(in[pos]));
+            s.stored += s.levels[h].size();
+            pos += 1 + size_t(in[pos]);
+        }
+        if (s.levels.empty())
+            s.levels.resize(1);
+        s.UpdateCapacity();
+        s.Compress();
+        return s;
+    }
+
+    TVectorD ToTVector() const {
+        vector<double> flat = ToVector();
+        TVectorD v(flat.size());
+        for (size_t i = 0; i < flat.size(); ++i)
+            v[i] = flat[i];
+        return v;
+    }
+
+    static QuantileSketch FromTVector(const TVectorD & v) {
+        vector<double> flat(v.GetNrows());
+        for (size_t i = 0; i < flat.size(); ++i)
+            flat[i] = v[i];
+        return FromVector(flat);
+    }
+
+private:
+    // a value and its weight
+    using Item = std::pair<double, double>;
+
+    // the top level holds k values, and each level below 2/3 as many, down to 2
+    size_t Capacity(size_t h) const {
+        double depth = double(levels.size()) - 1 - h;
+        return std::max(2, int(std::ceil(k*std::pow(2./3., depth))));
+    }
+
+    void UpdateCapacity() {
+        capacity = 0;
+        for (size_t h = 0; h < levels.size(); ++h)
+            capacity += Capacity(h);
+    }
+
+    // compacts the lowest full level until everything fits again
+    void Compress() {
+        while (stored >= capacity) {
+            for (size_t h = 0; h < levels.size(); ++h) {
+                if (levels[h].size() < Capacity(h))
+                    continue;
+                if (h + 1 == levels.size()) {
+                    levels.resize(levels.size() + 1);
+                    UpdateCapacity();
+                }
+                vector<double> & level = levels[h];
+                std::sort(level.begin(), level.end());
+                // an odd value out stays behind, so total weight is conserved
+                double leftover = level.back();
+                bool odd = level.size() % 2 == 1;
+                if (odd)
+                    level.pop_back();
+                for (size_t i = Coin(); i < level.size(); i += 2)
+                    levels[h + 1].push_back(level[i]);
+                stored -= level.size()/2;
+                level.clear();
+                if (odd)
+                    level.push_back(leftover);
+                break;
+            }
+        }
+    }
+
+    // which half of a compacted level survives. xorshift, so a sketch fed the same values in the
+    // same order is always the same
+    size_t Coin() {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return random & 1;
+    }
+
+    vector<Item> Items() const {
+        vector<Item> items;
+        for (size_t h = 0; h < levels.size(); ++h)
+            for (size_t i = 0; i < levels[h].size(); ++i)
+                items.push_back(Item(levels[h][i], std::ldexp(1., h)));
+        std::sort(items.begin(), items.end());
+        return items;
+    }
+
+    int k;
+    vector<vector<double>> levels;
+    long long n = 0;
+    double low = 0, high = 0;
+    // values held over all levels, and the sum of the level capacities
+    size_t stored = 0, capacity = 0;
+    unsigned long long random = 0x9E3779B97F4A7C15ULL;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include "SVJFinder.h"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cerrno>
+#include <atomic>
+#include <unistd.h>
+
+// per-file partial results on local disk, so that reruns over a grown file list only process the
+// new or changed files. an entry is keyed on the identity of the input file (path, size and
+// modification time) and lives under a directory named after a hash of the selection: its version
+// (SVJFinder::SELECTION_VERSION), the layout of the partials, and the variation and scan files.
+// any change to those starts a fresh set of entries; rebuilding the same selection does not
+class ResultCache {
+public:
+    ResultCache(string directory, SVJFinder & core) : directory(directory) {
+        string selection = string(SVJFinder::SELECTION_VERSION) + "\n" + core.Layout() + "\n" + ReadFile(core.variationSpec) + "\n" + ReadFile(core.scanSpec);
+        path = directory + "/" + Hash(selection);
+        MakeDirectory(directory);
+        MakeDirectory(path);
+    }
+
+    // fills p with the cached results of a file; false if there are none for its current version
+    bool Load(const string & filename, SVJFinder::Partial & p) {
+        string identity;
+        if (!Identify(filename, identity))
+            return false;
+        std::ifstream in(Entry(identity).c_str(), std::ios::binary);
+        string stored;
+        if (!in.is_open() || !getline(in, stored) || stored != identity)
+            return false;
+        try {
+            p = SVJFinder::Partial::Read(in);
+        }
+        catch (string &) {
+            return false;
+        }
+        return true;
+    }
+
+    // writes to a temporary file first, so an interrupted run never leaves a truncated entry
+    void Store(const string & filename, const SVJFinder::Partial & p) {
+        string identity;
+        if (!Identify(filename, identity))
+            return;
+        string entry = Entry(identity), temporary = entry + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+        std::ofstream out(temporary.c_str(), std::ios::binary);
+        out << identity << "\n";
+        p.Write(out);
+        out.close();
+        if (!out || std::rename(temporary.c_str(), entry.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw "Could not write cache entry for '" + filename + "'";
+        }
+    }
+
+    // 64 bit FNV-1a, as hex
+    static string Hash(const string & s) {
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t i = 0; i < s.size(); ++i) {
+            h ^= (unsigned char)s[i];
+            h *= 1099511628211ULL;
+        }
+        char buffer[17];
+        snprintf(buffer, sizeof(buffer), "%016llx", h);
+        return buffer;
+    }
+
+    const string directory;
+
+private:
+    bool Identify(const string & filename, string & identity) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0)
+            return false;
+        identity = filename + " " + std::to_string((long long)st.st_size) + " " + std::to_string((long long)st.st_mtime);
+        return true;
+    }
+
+    string Entry(const string & identity) {
+        return path + "/" + Hash(identity) + ".partial";
+    }
+
+    static string ReadFile(const string & filename) {
+        if (filename.empty())
+            return "";
+        std::ifstream in(filename.c_str());
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    static void MakeDirectory(const string & dir) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            throw "Could not create cache directory '" + dir + "'";
+    }
+
+    string path;
+    std::atomic<size_t> counter{0};
+};
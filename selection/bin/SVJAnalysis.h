@@ -0,0 +1,512 @@
+#pragma once
+#include "TLorentzMock.h"
+#include "SVJFinder.h"
+#include <math.h>
+#include "DataFormats/Math/interface/deltaPhi.h"
+#include <fstream>
+#include <sstream>
+
+using std::sin;
+using std::cos;
+using std::sqrt; 
+using std::abs; 
+
+namespace Vetos {
+    inline bool LeptonVeto(TLorentzMock& lepton, double minPt=10, double maxEta=2.4) {
+        return fabs(lepton.Pt()) > minPt && fabs(lepton.Eta()) < maxEta;
+    }
+ 
+    inline bool IsolationVeto(double &iso, double minIso=0.4) {
+        return iso >= minIso;
+    }
+
+    inline bool JetEtaVeto(TLorentzVector& jet, double maxEta=2.4) {
+        return abs(jet.Eta()) < maxEta;
+    }
+
+    inline bool JetDeltaEtaVeto(TLorentzVector& jet1, TLorentzVector& jet2, double maxDeltaEta=1.5) {
+        return abs(jet1.Eta() - jet2.Eta()) < maxDeltaEta;
+    }
+
+    inline bool JetPtVeto(TLorentzVector& jet, double minPt=200.) {
+        return jet.Pt() > minPt;
+    }
+}
+
+// cut values and jet energy scale of one variation of the selection; defaults are the nominal selection
+struct Thresholds {
+    string name = "nominal";
+    double jetScale = 1.;
+    double leptonPt = 10.;
+    double leptonEta = 2.4;
+    double leptonIso = 0.4;
+    double jetEta = 2.4;
+    double jetDeltaEta = 1.5;
+    double jetPt = 200.;
+    double metRatio = 0.15;
+    double mt = 1500.;
+    double metRatioTight = 0.25;
+
+    // sets one threshold from a 'key=value' token
+    void Set(const string & token) {
+        size_t eq = token.find('=');
+        if (eq == string::npos)
+            throw "Malformed variation setting '" + token + "' in variation " + name;
+        string key = token.substr(0, eq);
+        double value = std::stod(token.substr(eq + 1));
+        if (key == "jetScale") jetScale = value;
+        else if (key == "leptonPt") leptonPt = value;
+        else if (key == "leptonEta") leptonEta = value;
+        else if (key == "leptonIso") leptonIso = value;
+        else if (key == "jetEta") jetEta = value;
+        else if (key == "jetDeltaEta") jetDeltaEta = value;
+        else if (key == "jetPt") jetPt = value;
+        else if (key == "metRatio") metRatio = value;
+        else if (key == "mt") mt = value;
+        else if (key == "metRatioTight") metRatioTight = value;
+        else throw "Unknown variation setting '" + key + "' in variation " + name;
+    }
+};
+
+inline size_t leptonCount(vector<TLorentzMock>* leptons, vector<double>* isos, const Thresholds & t=Thresholds()) {
+    size_t n = 0;
+    // size_t lepton_size = std::min(leptons->size(), isos->size());
+    for (size_t i = 0; i < leptons->size(); ++i)
+        if (Vetos::LeptonVeto(leptons->at(i), t.leptonPt, t.leptonEta) && Vetos::IsolationVeto(isos->at(i), t.leptonIso)) 
+            n++;
+    return n;
+}
+
+class SVJAnalysis {
+public:
+    // registers the histograms and collections of the selection with the core
+    SVJAnalysis(SVJFinder & core) : core(core) {
+        // variations share the decoded event, but each has its own cutflow, histograms and selection
+        thresholds.push_back(Thresholds());
+        if (core.variationSpec.size() > 0)
+            ReadVariations(core.variationSpec);
+        if (core.scanSpec.size() > 0)
+            ReadScan(core.scanSpec);
+        DescribeCuts();
+
+        // add histogram tracking
+        core.AddHist(Hists::dEta, "h_dEta", "#Delta#eta(j0,j1)", 100, 0, 10);
+        core.AddHist(Hists::dPhi, "h_dPhi", "#Delta#Phi(j0,j1)", 100, 0, 5);
+        core.AddHist(Hists::tRatio,  "h_transverseratio", "MET/M_{T}", 100, 0, 1);
+        core.AddHist(Hists::met2, "h_Mt", "m_{T}", 750, 0, 7500);
+        core.AddHist(Hists::mjj, "h_Mjj", "m_{JJ}", 750, 0, 7500);
+        core.AddHist(Hists::metPt, "h_METPt", "MET_{p_{T}}", 100, 0, 2000);
+        
+        // histograms for pre/post PT wrt PT cut (i.e. after MET, before PT && afer PT)
+        core.AddHist(Hists::pre_1pt, "h_pre_1pt", "pre PT cut leading jet pt", 100, 0, 2500);
+        core.AddHist(Hists::pre_2pt, "h_pre_2pt", "pre PT cut subleading jet pt", 100, 0, 2500);
+        core.AddHist(Hists::post_1pt, "h_post_1pt", "post PT cut leading jet pt", 100, 0, 2500);
+        core.AddHist(Hists::post_2pt, "h_post_2pt", "post PT cut subleading jet pt", 100, 0, 2500);
+
+        // histograms for pre/post lepton count wrt lepton cut
+        core.AddHist(Hists::pre_lep, "h_pre_lep", "lepton count pre-cut", 10, 0, 10);
+        core.AddHist(Hists::post_lep, "h_post_lep", "lepton count post-cut", 10, 0, 10);
+
+        // mt2 pre cut
+        core.AddHist(Hists::pre_MT, "h_pre_MT", "pre-cut m_{T}", 750, 0, 7500);
+        core.AddHist(Hists::pre_mjj, "h_pre_Mjj", "pre-cut m_{JJ}", 750, 0, 7500); 
+        core.AddHist(Hists::pre_metPt, "h_pre_METPt", "pre-cut MET_{p_{T}}", 100, 0, 2000);
+
+        // N-1 distributions of the variable of every cut which has one. the jet count has none: the
+        // cuts after it need two jets to be evaluated at all, so its N-1 histogram could only
+        // ever hold counts of two or more. they are why the preselection below cannot drop the
+        // jets of lepton-vetoed entries: every cut is evaluated for them, so they cost a full read
+        core.AddNMinusOne(Cuts::leptonCounts, "h_n1_leptons", "N-1 passing lepton count", 10, 0, 10);
+        core.AddNMinusOne(Cuts::jetEtas, "h_n1_jetEta", "N-1 max |#eta| of leading jets", 100, 0, 5);
+        core.AddNMinusOne(Cuts::jetDeltaEtas, "h_n1_dEta", "N-1 #Delta#eta(j0,j1)", 100, 0, 10);
+        // the two MET/M_T cuts leave each other out, or the loose one would only see values above
+        // the tight threshold
+        core.AddNMinusOne(Cuts::metRatio, "h_n1_metRatio", "N-1 MET/M_{T}", 100, 0, 1, {Cuts::metRatioTight});
+        core.AddNMinusOne(Cuts::jetPt, "h_n1_jetPt", "N-1 subleading jet pt", 100, 0, 2500);
+        core.AddNMinusOne(Cuts::metValue, "h_n1_Mt", "N-1 m_{T}", 750, 0, 7500);
+        core.AddNMinusOne(Cuts::metRatioTight, "h_n1_metRatioTight", "N-1 tight MET/M_{T}", 100, 0, 1, {Cuts::metRatio});
+
+        // quantile sketches of the key distributions, before and after the cuts
+        if (core.Sketching()) {
+            core.AddSketch(Hists::pre_MT);
+            core.AddSketch(Hists::met2);
+            core.AddSketch(Hists::pre_mjj);
+            core.AddSketch(Hists::mjj);
+            core.AddSketch(Hists::pre_metPt);
+            core.AddSketch(Hists::metPt);
+            core.AddSketch(Hists::pre_1pt);
+            core.AddSketch(Hists::post_1pt);
+        }
+
+        // per-event values of the selected events, for in-process runs and .npy output
+        if (core.Recording()) {
+            core.AddColumn(Columns::MT, "MT");
+            core.AddColumn(Columns::Mjj, "Mjj");
+            core.AddColumn(Columns::MET, "MET");
+            core.AddColumn(Columns::METPhi, "METPhi");
+            core.AddColumn(Columns::dEta, "dEta");
+            core.AddColumn(Columns::dPhi, "dPhi");
+            core.AddColumn(Columns::tRatio, "transverseRatio");
+            core.AddColumn(Columns::pt1, "leadingJetPt");
+            core.AddColumn(Columns::eta1, "leadingJetEta");
+            core.AddColumn(Columns::phi1, "leadingJetPhi");
+            core.AddColumn(Columns::m1, "leadingJetM");
+            core.AddColumn(Columns::pt2, "subleadingJetPt");
+            core.AddColumn(Columns::eta2, "subleadingJetEta");
+            core.AddColumn(Columns::phi2, "subleadingJetPhi");
+            core.AddColumn(Columns::m2, "subleadingJetM");
+        }
+        
+        // stage 1, read for every entry: the object counts and the met
+        nJets = core.AddVar<Int_t>("nJets", "Jet_size");
+        nElectrons = core.AddVar<Int_t>("nElectrons", "Electron_size");
+        nMuons = core.AddVar<Int_t>("nMuons", "MuonLoose_size");
+        metFull_Pt = core.AddVar<Float_t>("metMET", "MissingET.MET");
+        metFull_Phi = core.AddVar<Float_t>("metPhi", "MissingET.Phi");
+
+        // stage 2, only read for entries with two jets or any lepton candidate. entries with
+        // neither fail the jet count with no passing lepton, which the counts alone tell, and
+        // never reach a histogram needing the kinematics. jets and leptons share the stage: an
+        // entry vetoed by its leptons still needs its jets, as h_n1_leptons takes the entries
+        // which fail the lepton cut alone, and only the jet cuts can tell which those are
+        core.LoadInStage(2);
+        core.SetPreselection([this]() { return *nJets > 1 || *nElectrons + *nMuons > 0; });
+
+        // add componenets for jets (tlorentz)
+
+        nominalJets = Jets = core.AddLorentz("Jet", {"Jet.PT","Jet.Eta","Jet.Phi","Jet.Mass"});
+        Electrons = core.AddLorentzMock<Float_t, Float_t>("Electron", {"Electron.PT","Electron.Eta"});
+        Muons = core.AddLorentzMock<Float_t, Float_t>("Muon", {"MuonLoose.PT", "MuonLoose.Eta"});
+        MuonIsolation = core.AddVectorVar<Float_t>("MuonIsolation", "MuonLoose.IsolationVarRhoCorr");
+        ElectronIsolation = core.AddVectorVar<Float_t>("ElectronIsolation", "Electron.IsolationVarRhoCorr"); 
+        core.LoadInStage(1);
+
+        // EFlow objects, for selected events only: reclustered into jets, and stored as the
+        // constituents of the two leading jets
+        if (core.reclusterRadii.size() > 0 || core.constituentDR > 0)
+            EFlow = core.AddEFlow("EFlow");
+        if (core.reclusterRadii.size() > 0) {
+            JetClustering::Algorithm algorithm = JetClustering::FromName(core.reclusterAlgorithm);
+            reclustered = core.AddReclustered("Reclustered", EFlow, core.reclusterRadii, algorithm, core.reclusterPtMin);
+            for (size_t i = 0; i < core.reclusterRadii.size(); ++i) {
+                string name = "h_" + JetClustering::ShortName(algorithm, core.reclusterRadii[i]);
+                string label = " (" + core.reclusterAlgorithm + " R=" + to_string(core.reclusterRadii[i]).substr(0, 3) + ")";
+                reclusterHists.push_back({
+                    core.AddHist(name + "_n", "jet count" + label, 50, 0, 50),
+                    core.AddHist(name + "_pt1", "leading jet pt" + label, 100, 0, 2500),
+                    core.AddHist(name + "_m1", "leading jet mass" + label, 100, 0, 1000),
+                    core.AddHist(name + "_Mjj", "m_{JJ}" + label, 750, 0, 7500)
+                });
+            }
+        }
+    }
+
+    // reads '<name> <key>=<value> ...' lines; unset keys keep their nominal values
+    void ReadVariations(string filename) {
+        std::ifstream f(filename.c_str());
+        if (!f.is_open())
+            throw "Could not open variation file '" + filename + "'";
+        string line;
+        while (getline(f, line)) {
+            std::stringstream ss(line);
+            Thresholds t;
+            if (!(ss >> t.name) || t.name[0] == '#')
+                continue;
+            string token;
+            while (ss >> token)
+                t.Set(token);
+            core.AddVariation(t.name);
+            thresholds.push_back(t);
+        }
+    }
+
+    // reads '<cut> <bins> <min> <max>' lines, one per scanned cut. scannable cuts are mt
+    // (Cuts::metValue), metRatioTight and jetPt, which scans the subleading jet pt
+    void ReadScan(string filename) {
+        std::ifstream f(filename.c_str());
+        if (!f.is_open())
+            throw "Could not open scan file '" + filename + "'";
+        vector<SVJFinder::ScanAxis> axes;
+        string line;
+        while (getline(f, line)) {
+            std::stringstream ss(line);
+            SVJFinder::ScanAxis axis;
+            if (!(ss >> axis.name) || axis.name[0] == '#')
+                continue;
+            if (!(ss >> axis.bins >> axis.min >> axis.max))
+                throw "Malformed scan line '" + line + "'";
+            if (axis.name == "mt") scanned.push_back(Cuts::metValue);
+            else if (axis.name == "metRatioTight") scanned.push_back(Cuts::metRatioTight);
+            else if (axis.name == "jetPt") scanned.push_back(Cuts::jetPt);
+            else throw "Cut '" + axis.name + "' cannot be scanned";
+            axes.push_back(axis);
+        }
+        core.AddScan(axes);
+    }
+
+    // runs every variation of the selection on one entry of the core's chain. the entry is only
+    // read and decoded once
+    void Process(Int_t entry) {
+        core.GetEntry(entry);
+        for (size_t v = 0; v < thresholds.size(); ++v) {
+            core.SetVariation(v);
+            if (thresholds[v].jetScale == 1.) {
+                Jets = nominalJets;
+            }
+            else {
+                // a common scale factor keeps the pt ordering of the jets
+                scaledJets = *nominalJets;
+                for (size_t i = 0; i < scaledJets.size(); ++i)
+                    scaledJets[i] *= thresholds[v].jetScale;
+                Jets = &scaledJets;
+            }
+            Select(entry, thresholds[v]);
+        }
+        core.SetVariation(0);
+    }
+
+private:
+    // how each cut of each variation is made, for zone maps (see SVJFinder::DescribeCut). the
+    // jet energy scale leaves the jet etas, and the order of the jets, as they are
+    void DescribeCuts() {
+        for (size_t v = 0; v < thresholds.size(); ++v) {
+            const Thresholds & t = thresholds[v];
+            std::stringstream leptons, scale;
+            leptons << std::setprecision(17) << "leptonPt=" << t.leptonPt << " leptonEta=" << t.leptonEta << " leptonIso=" << t.leptonIso;
+            scale << std::setprecision(17) << "jetScale=" << t.jetScale;
+            core.DescribeCut(v, Cuts::leptonCounts, leptons.str(), '<', 1);
+            core.DescribeCut(v, Cuts::jetCounts, "nJets", '>', 1);
+            core.DescribeCut(v, Cuts::jetEtas, "", '<', t.jetEta);
+            core.DescribeCut(v, Cuts::jetDeltaEtas, "", '<', t.jetDeltaEta);
+            core.DescribeCut(v, Cuts::metRatio, scale.str(), '>', t.metRatio);
+            core.DescribeCut(v, Cuts::jetPt, scale.str(), '>', t.jetPt);
+            core.DescribeCut(v, Cuts::jetDiJet, "");
+            core.DescribeCut(v, Cuts::metValue, scale.str(), '>', t.mt);
+            core.DescribeCut(v, Cuts::metRatioTight, scale.str(), '>', t.metRatioTight);
+            core.DescribeCut(v, Cuts::selection, "");
+        }
+    }
+
+    void Select(Int_t entry, const Thresholds & t) {
+        // init
+        core.InitCuts();
+
+        // require zero leptons which pass cuts
+        // pre lepton cut
+        core.Fill(Hists::pre_lep, Muons->size() + Electrons->size());
+
+        // made it here
+
+        size_t nLeptons = leptonCount(Muons, MuonIsolation, t) + leptonCount(Electrons, ElectronIsolation, t);
+        core.Cut(
+            nLeptons < 1,
+            Cuts::leptonCounts,
+            nLeptons
+            );
+
+        // didn't make it here 
+
+        // the remaining cuts are still evaluated for events failing this one, for its N-1
+        // histogram; the cutflow stops counting at the first failed cut either way
+        if (core.Cut(Cuts::leptonCounts))
+            core.Fill(Hists::post_lep, Muons->size() + Electrons->size());
+
+
+        // require more than 1 jet; counted from stage 1, so also known for entries without jets read
+        core.Cut(
+            *nJets > 1,
+            Cuts::jetCounts,
+            *nJets
+            );
+
+
+
+        // rest of cuts, dependent on jetcount
+        if (core.Cut(Cuts::jetCounts)) {
+
+            TLorentzVector Vjj = Jets->at(0) + Jets->at(1);
+            double metFull_Py = (*metFull_Pt)*sin(*metFull_Phi);
+            double metFull_Px = (*metFull_Pt)*cos(*metFull_Phi);
+            double Mjj = Vjj.M(); // SAVE
+            double Mjj2 = Mjj*Mjj;
+            double ptjj = Vjj.Pt();
+            double ptjj2 = ptjj*ptjj;
+            double ptMet = Vjj.Px()*metFull_Px + Vjj.Py()*metFull_Py;
+            double MT2 = sqrt(Mjj2 + 2*(sqrt(Mjj2 + ptjj2)*(*metFull_Pt) - ptMet)); // SAVE
+
+            // fill pre-cut MT2 histogram, for events passing the lepton veto as before the N-1
+            // histograms kept the cuts after it running
+            if (core.Cut(Cuts::leptonCounts)) {
+                core.Fill(Hists::pre_MT, MT2); 
+                core.Fill(Hists::pre_mjj, Mjj); 
+                core.Fill(Hists::pre_metPt, *metFull_Pt);
+            }
+
+            // leading jet etas both meet eta veto
+            core.Cut(
+                Vetos::JetEtaVeto(Jets->at(0), t.jetEta) && Vetos::JetEtaVeto(Jets->at(1), t.jetEta), 
+                Cuts::jetEtas,
+                std::max(fabs(Jets->at(0).Eta()), fabs(Jets->at(1).Eta()))
+                );
+        
+            // leading jets meet delta eta veto
+            core.Cut(
+                Vetos::JetDeltaEtaVeto(Jets->at(0), Jets->at(1), t.jetDeltaEta),
+                Cuts::jetDeltaEtas,
+                fabs(Jets->at(0).Eta() - Jets->at(1).Eta())
+                );
+
+            // ratio between calculated mt2 of dijet system and missing momentum is not negligible
+            core.Cut(
+                ((*metFull_Pt) / MT2) > t.metRatio,
+                Cuts::metRatio,
+                (*metFull_Pt) / MT2
+                );
+
+            if (scanned.size() > 0)
+                Scan(t, MT2);
+
+            // require both leading jets to have transverse momentum greater than 200; the pre-cut
+            // histograms only take events passing the lepton veto, as before the N-1 histograms
+            if (core.Cut(Cuts::leptonCounts)) {
+                core.Fill(Hists::pre_1pt, Jets->at(0).Pt()); 
+                core.Fill(Hists::pre_2pt, Jets->at(1).Pt()); 
+            }
+
+            core.Cut(
+                Vetos::JetPtVeto(Jets->at(0), t.jetPt) && Vetos::JetPtVeto(Jets->at(1), t.jetPt),
+                Cuts::jetPt,
+                std::min(Jets->at(0).Pt(), Jets->at(1).Pt())
+                );
+            // lepton-vetoed events run on for the N-1 histograms, but stay out of these as well
+            if (core.Cut(Cuts::leptonCounts) && core.Cut(Cuts::jetPt)) {
+                core.Fill(Hists::post_1pt, Jets->at(0).Pt());
+                core.Fill(Hists::post_2pt, Jets->at(1).Pt());
+            }
+
+            // conglomerate cut, whether jet is a dijet
+            core.Cut(
+                core.Cut(Cuts::jetEtas) && core.Cut(Cuts::jetPt),
+                Cuts::jetDiJet
+                );
+
+            // magnitude of MT > 1500 
+            core.Cut(
+                MT2 > t.mt,
+                Cuts::metValue,
+                MT2
+                );
+
+            // tighter MET/MT ratio
+            core.Cut(
+                ((*metFull_Pt) / MT2) > t.metRatioTight,
+                Cuts::metRatioTight,
+                (*metFull_Pt) / MT2
+                );
+             
+            // final selection cut
+            core.Cut(
+                core.CutsRange(0, int(Cuts::selection)) && core.Cut(Cuts::metRatioTight),
+                Cuts::selection
+            ); 
+
+            // save histograms, if passing
+            if (core.Cut(Cuts::selection)) {
+                core.UpdateSelectionIndex(entry); 
+                core.Fill(Hists::dEta, fabs(Jets->at(0).Eta() - Jets->at(1).Eta())); 
+                core.Fill(Hists::dPhi, fabs(reco::deltaPhi(Jets->at(0).Phi(), Jets->at(1).Phi())));
+                core.Fill(Hists::tRatio, (*metFull_Pt) / MT2);
+                core.Fill(Hists::mjj, Vjj.M());
+                core.Fill(Hists::met2, MT2);
+                core.Fill(Hists::metPt, *metFull_Pt);
+                FillReclustered();
+
+                if (core.Recording()) {
+                    core.Record(Columns::MT, MT2);
+                    core.Record(Columns::Mjj, Mjj);
+                    core.Record(Columns::MET, *metFull_Pt);
+                    core.Record(Columns::METPhi, *metFull_Phi);
+                    core.Record(Columns::dEta, fabs(Jets->at(0).Eta() - Jets->at(1).Eta()));
+                    core.Record(Columns::dPhi, fabs(reco::deltaPhi(Jets->at(0).Phi(), Jets->at(1).Phi())));
+                    core.Record(Columns::tRatio, (*metFull_Pt) / MT2);
+                    core.Record(Columns::pt1, Jets->at(0).Pt());
+                    core.Record(Columns::eta1, Jets->at(0).Eta());
+                    core.Record(Columns::phi1, Jets->at(0).Phi());
+                    core.Record(Columns::m1, Jets->at(0).M());
+                    core.Record(Columns::pt2, Jets->at(1).Pt());
+                    core.Record(Columns::eta2, Jets->at(1).Eta());
+                    core.Record(Columns::phi2, Jets->at(1).Phi());
+                    core.Record(Columns::m2, Jets->at(1).M());
+                    if (core.constituentDR > 0) {
+                        core.LoadLate();
+                        core.RecordConstituents(*Jets, *EFlow);
+                    }
+                }
+            }
+
+        }
+        core.UpdateCutFlow(); 
+    }
+
+    // distributions of the reclustered jets of a selected event, at each radius
+    void FillReclustered() {
+        if (reclustered.size() == 0)
+            return;
+        core.LoadLate();
+        for (size_t i = 0; i < reclustered.size(); ++i) {
+            const vector<TLorentzVector> & jets = *reclustered[i];
+            core.Fill(reclusterHists[i][0], jets.size());
+            if (jets.size() > 0) {
+                core.Fill(reclusterHists[i][1], jets[0].Pt());
+                core.Fill(reclusterHists[i][2], jets[0].M());
+            }
+            if (jets.size() > 1)
+                core.Fill(reclusterHists[i][3], (jets[0] + jets[1]).M());
+        }
+    }
+
+    // records the scanned values of an event which passes all other cuts of the final selection.
+    // called once the cuts up to Cuts::metRatio are known
+    void Scan(const Thresholds & t, double MT2) {
+        if (!core.CutsRange(0, int(Cuts::metRatio) + 1))
+            return;
+        double values[Cuts::COUNT] = {};
+        values[Cuts::jetPt] = std::min(Jets->at(0).Pt(), Jets->at(1).Pt());
+        values[Cuts::metValue] = MT2;
+        values[Cuts::metRatioTight] = (*metFull_Pt) / MT2;
+        bool passed[Cuts::COUNT] = {};
+        passed[Cuts::jetPt] = values[Cuts::jetPt] > t.jetPt;
+        passed[Cuts::metValue] = values[Cuts::metValue] > t.mt;
+        passed[Cuts::metRatioTight] = values[Cuts::metRatioTight] > t.metRatioTight;
+
+        vector<double> point;
+        for (size_t i = 0; i < scanned.size(); ++i) {
+            point.push_back(values[scanned[i]]);
+            passed[scanned[i]] = true;
+        }
+        if (passed[Cuts::jetPt] && passed[Cuts::metValue] && passed[Cuts::metRatioTight])
+            core.FillScan(point);
+    }
+
+    SVJFinder & core;
+    vector<Cuts::CutType> scanned;
+    vector<Thresholds> thresholds;
+
+    vector<TLorentzVector>* Jets;
+    vector<TLorentzVector>* nominalJets;
+    vector<TLorentzVector> scaledJets;
+    vector<TLorentzMock>* Electrons;
+    vector<TLorentzMock>* Muons;
+    vector<double>* MuonIsolation;
+    vector<double>* ElectronIsolation;
+    double* nJets;
+    double* nElectrons;
+    double* nMuons;
+    double* metFull_Pt;
+    double* metFull_Phi;
+
+    vector<TLorentzVector>* EFlow = nullptr;
+    // per radius: the reclustered jets, and the indices of their n, pt1, m1 and Mjj histograms
+    vector<vector<TLorentzVector>*> reclustered;
+    vector<vector<size_t>> reclusterHists;
+};
@@ -1,7 +1,11 @@
+#pragma once
 #include "TLeaf.h"
 #include "TLorentzVector.h"
 #include "TFile.h"
 #include "TH1F.h"
+#include "TH2D.h"
+#include "THn.h"
+#include "TEntryList.h"
 #include <vector>
 #include <algorithm>
 #include <iostream>
@@ -17,8 +21,17 @@
 #include <map>
 #include <cassert>
 #include <chrono>
+#include <memory>
+#include <functional>
 #include "ParallelTreeChain.h"
+#include "QuantileSketch.h"
+#include "NpyWriter.h"
+#include "Collection.h"
+#include "ZoneMap.h"
+#include "LiveSnapshot.h"
 #include "TMath.h"
+#include "TEfficiency.h"
+#include <random>
 #include <stdexcept> 
 
 using std::fabs;
@@ -33,14 +46,6 @@ using std::to_string;
 using std::stringstream; 
 using std::setw;
 
-namespace vectorTypes{
-    enum vectorType {
-        Lorentz,
-        Mock,
-        Map
-    };
-};
-
 namespace Cuts {
     enum CutType {
         leptonCounts,
@@ -89,22 +94,249 @@ namespace Hists {
 
         pre_MT,
         pre_mjj,
+        pre_metPt,
 
         COUNT
     };
 }; 
 
+namespace Columns {
+    enum ColumnType {
+        MT,
+        Mjj,
+        MET,
+        METPhi,
+        dEta,
+        dPhi,
+        tRatio,
+        pt1,
+        eta1,
+        phi1,
+        m1,
+        pt2,
+        eta2,
+        phi2,
+        m2,
+
+        COUNT
+    };
+};
+
+namespace Constituents {
+    // columns of the stored jet constituents, named as in the converter
+    vector<string> Names {"Eta", "Phi", "PT", "Rapidity", "Energy"};
+};
+
 // import for backportability (;-<)
-using namespace vectorTypes; 
 using namespace Cuts; 
 
+template<typename analysis> class SamplePool;
+template<typename analysis> class Coordinator;
+template<typename analysis> class RemoteWorker;
+template<typename analysis> class StreamPool;
+class SelectionSession;
+class SelectionService;
+
 class SVJFinder {
+    template<typename analysis> friend class SamplePool;
+    template<typename analysis> friend class StreamPool;
+    template<typename analysis> friend class Coordinator;
+    template<typename analysis> friend class RemoteWorker;
+    friend class SelectionSession;
+    friend class SelectionService;
+
 public:
+    // results of processing part of a sample, handed from a worker to the core which owns the sample
+    struct Partial {
+        struct Results {
+            vector<int> cutflow;
+            // bin contents including under/overflow, in AddHist order
+            vector<vector<double>> hists;
+            vector<double> histEntries;
+            // selected entries of each input file
+            vector<vector<size_t>> selection;
+            // threshold scan counts, including under/overflow
+            vector<double> scan;
+            // quantile sketches in AddSketch order, in QuantileSketch::ToVector form
+            vector<vector<double>> sketches;
+            // derived variables of selected events in AddColumn order, and the tree and entry
+            // each row belongs to
+            vector<vector<double>> columns;
+            vector<pair<size_t, size_t>> rows;
+            // constituents of the two leading jets of each row: one flat array per
+            // Constituents::Names entry, and the number of constituents of each jet
+            vector<vector<double>> constituents;
+            vector<size_t> jetSizes;
+        };
+        vector<string> trees;
+        // one set of results per variation, in AddVariation order
+        vector<Results> variations;
+
+        // binary form, for partials which leave the process; both ends must share the architecture
+        void Write(std::ostream & out) const {
+            int version = PARTIAL_VERSION;
+            Put(out, version);
+            Put(out, trees);
+            Put(out, variations);
+        }
+
+        // adds another partial of the same layout; rows of trees present in both are joined.
+        // trees are only to be added through here (or replaced wholesale), as their slots are
+        // looked up in an index kept next to them
+        void Add(const Partial & other) {
+            if (variations.empty()) {
+                *this = other;
+                return;
+            }
+            assert(other.variations.size() == variations.size());
+            if (slotOf.size() != trees.size()) {
+                slotOf.clear();
+                for (size_t i = 0; i < trees.size(); ++i)
+                    slotOf[trees[i]] = i;
+            }
+            vector<size_t> slots;
+            for (size_t i = 0; i < other.trees.size(); ++i) {
+                auto it = slotOf.insert(std::make_pair(other.trees[i], trees.size())).first;
+                if (it->second == trees.size())
+                    trees.push_back(other.trees[i]);
+                slots.push_back(it->second);
+            }
+            for (size_t v = 0; v < variations.size(); ++v) {
+                Results & r = variations[v];
+                const Results & o = other.variations[v];
+                for (size_t i = 0; i < r.cutflow.size(); ++i)
+                    r.cutflow[i] += o.cutflow[i];
+                for (size_t i = 0; i < r.hists.size(); ++i) {
+                    for (size_t b = 0; b < r.hists[i].size(); ++b)
+                        r.hists[i][b] += o.hists[i][b];
+                    r.histEntries[i] += o.histEntries[i];
+                }
+                for (size_t i = 0; i < r.scan.size(); ++i)
+                    r.scan[i] += o.scan[i];
+                for (size_t i = 0; i < r.sketches.size(); ++i) {
+                    QuantileSketch s = QuantileSketch::FromVector(r.sketches[i]);
+                    s.Merge(QuantileSketch::FromVector(o.sketches[i]));
+                    r.sketches[i] = s.ToVector();
+                }
+                for (size_t i = 0; i < r.columns.size(); ++i)
+                    r.columns[i].insert(r.columns[i].end(), o.columns[i].begin(), o.columns[i].end());
+                for (size_t i = 0; i < o.rows.size(); ++i)
+                    r.rows.push_back(pair<size_t, size_t>(slots[o.rows[i].first], o.rows[i].second));
+                for (size_t i = 0; i < r.constituents.size(); ++i)
+                    r.constituents[i].insert(r.constituents[i].end(), o.constituents[i].begin(), o.constituents[i].end());
+                r.jetSizes.insert(r.jetSizes.end(), o.jetSizes.begin(), o.jetSizes.end());
+                r.selection.resize(trees.size());
+                for (size_t i = 0; i < slots.size(); ++i)
+                    r.selection[slots[i]].insert(r.selection[slots[i]].end(), o.selection[i].begin(), o.selection[i].end());
+            }
+        }
+
+        // the cutflow, histograms, scan and sketches alone: the results which are the same size
+        // however many events passed, without the selection, rows and constituents
+        Partial Summary() const {
+            Partial s;
+            for (size_t v = 0; v < variations.size(); ++v) {
+                const Results & r = variations[v];
+                Results o;
+                o.cutflow = r.cutflow;
+                o.hists = r.hists;
+                o.histEntries = r.histEntries;
+                o.scan = r.scan;
+                o.sketches = r.sketches;
+                s.variations.push_back(o);
+            }
+            return s;
+        }
+
+        static Partial Read(std::istream & in) {
+            Partial p;
+            int version = 0;
+            Get(in, version);
+            if (version != PARTIAL_VERSION)
+                throw "Partial has version " + std::to_string(version) + ", expected " + std::to_string(PARTIAL_VERSION);
+            Get(in, p.trees);
+            Get(in, p.variations);
+            return p;
+        }
+
+    private:
+        static const int PARTIAL_VERSION = 4;
+
+        // slot of each tree, for Add
+        std::map<string, size_t> slotOf;
+
+        template<typename t>
+        static void Put(std::ostream & out, const t & value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(t));
+        }
+
+        static void Put(std::ostream & out, const string & value) {
+            Put(out, value.size());
+            out.write(value.data(), value.size());
+        }
+
+        static void Put(std::ostream & out, const Results & r) {
+            Put(out, r.cutflow);
+            Put(out, r.hists);
+            Put(out, r.histEntries);
+            Put(out, r.selection);
+            Put(out, r.scan);
+            Put(out, r.sketches);
+            Put(out, r.columns);
+            Put(out, r.rows);
+            Put(out, r.constituents);
+            Put(out, r.jetSizes);
+        }
+
+        template<typename t>
+        static void Put(std::ostream & out, const vector<t> & values) {
+            Put(out, values.size());
+            for (size_t i = 0; i < values.size(); ++i)
+                Put(out, values[i]);
+        }
+
+        template<typename t>
+        static void Get(std::istream & in, t & value) {
+            if (!in.read(reinterpret_cast<char*>(&value), sizeof(t)))
+                throw string("Truncated partial");
+        }
+
+        static void Get(std::istream & in, string & value) {
+            size_t n = 0;
+            Get(in, n);
+            value.resize(n);
+            if (n > 0 && !in.read(&value[0], n))
+                throw string("Truncated partial");
+        }
+
+        static void Get(std::istream & in, Results & r) {
+            Get(in, r.cutflow);
+            Get(in, r.hists);
+            Get(in, r.histEntries);
+            Get(in, r.selection);
+            Get(in, r.scan);
+            Get(in, r.sketches);
+            Get(in, r.columns);
+            Get(in, r.rows);
+            Get(in, r.constituents);
+            Get(in, r.jetSizes);
+        }
+
+        template<typename t>
+        static void Get(std::istream & in, vector<t> & values) {
+            size_t n = 0;
+            Get(in, n);
+            values.resize(n);
+            for (size_t i = 0; i < n; ++i)
+                Get(in, values[i]);
+        }
+    };
+
     /// CON/DESTRUCTORS
     ///
 
         // constructor, requires argv as input
-        SVJFinder(char **argv) {
+        SVJFinder(int argc, char **argv) {
             start();
             tStart(programstart); 
             log("ROOT");
@@ -131,29 +363,139 @@ public:
             if (nMin < 0) 
                 nMin = 0; 
 
+            // optional flags, after the positional arguments
+            for (int i = 9; i < argc; ++i) {
+                string opt = argv[i];
+                if (opt == "--manifest")
+                    manifest = true;
+                else if (opt == "--stream")
+                    streaming = true;
+                else if (opt == "--threads" && i + 1 < argc)
+                    nThreads = std::max(1, std::stoi(argv[++i]));
+                else if (opt == "--no-numa")
+                    numa = false;
+                else if (opt == "--variations" && i + 1 < argc)
+                    variationSpec = argv[++i];
+                else if (opt == "--scan" && i + 1 < argc)
+                    scanSpec = argv[++i];
+                else if (opt == "--coordinator" && i + 1 < argc)
+                    coordinatorPort = std::stoi(argv[++i]);
+                else if (opt == "--worker" && i + 1 < argc)
+                    coordinatorAddress = argv[++i];
+                else if (opt == "--chunk" && i + 1 < argc)
+                    chunkSize = std::stoll(argv[++i]);
+                else if (opt == "--cache" && i + 1 < argc)
+                    cacheDir = argv[++i];
+                else if (opt == "--stage" && i + 1 < argc)
+                    stageDir = argv[++i];
+                else if (opt == "--stage-size" && i + 1 < argc)
+                    stageSize = (long long)(std::stod(argv[++i])*1e9);
+                else if (opt == "--sketch" && i + 1 < argc)
+                    sketchSize = std::stoi(argv[++i]);
+                else if (opt == "--npy")
+                    npy = true;
+                else if (opt == "--sample" && i + 1 < argc)
+                    samplePrecision = std::stod(argv[++i]);
+                else if (opt == "--constituents" && i + 1 < argc)
+                    constituentDR = std::stod(argv[++i]);
+                else if (opt == "--recluster" && i + 1 < argc)
+                    reclusterRadii = ParseRadii(argv[++i]);
+                else if (opt == "--recluster-alg" && i + 1 < argc)
+                    reclusterAlgorithm = argv[++i];
+                else if (opt == "--recluster-ptmin" && i + 1 < argc)
+                    reclusterPtMin = std::stod(argv[++i]);
+                else if (opt == "--zones" && i + 1 < argc)
+                    zoneDir = argv[++i];
+                else if (opt == "--live" && i + 1 < argc)
+                    livePath = argv[++i];
+                else
+                    throw "Unknown option '" + opt + "'";
+            }
+
+            if (manifest)
+                log("Reading samples from manifest " + inputspec);
+            if (streaming)
+                log("Streaming input files from " + inputspec);
+            if (nThreads > 1)
+                log("Running with " + to_string(nThreads) + " threads");
+            if (reclusterRadii.size() > 0)
+                log("Reclustering EFlow jets with " + reclusterAlgorithm + " at " + to_string(reclusterRadii.size()) + " radii, keeping jets above " + to_string(reclusterPtMin) + " GeV");
+            if (variationSpec.size() > 0)
+                log("Reading variations from " + variationSpec);
+            if (scanSpec.size() > 0)
+                log("Reading threshold scan from " + scanSpec);
+            if (coordinatorPort > 0)
+                log("Coordinating workers on port " + to_string(coordinatorPort));
+            if (coordinatorAddress.size() > 0)
+                log("Working for coordinator at " + coordinatorAddress);
+            if (cacheDir.size() > 0)
+                log("Caching per-file results in " + cacheDir);
+            if (zoneDir.size() > 0)
+                log("Skipping clusters by the zone maps in " + zoneDir);
+            if (livePath.size() > 0)
+                log("Publishing live snapshots of the results to " + livePath);
+            if (stageDir.size() > 0)
+                log("Staging up to " + to_string(stageSize/1000000000.) + " GB of inputs in " + stageDir);
+            if (sketchSize > 0)
+                log("Keeping quantile sketches with k=" + to_string(sketchSize));
+            // constituents are stored per row, so they come with the columns and their rows
+            if (constituentDR > 0) {
+                npy = true;
+                log("Writing constituents within dR < " + to_string(constituentDR) + " of the leading jets of selected events to ragged .npy files");
+            }
+            if (npy)
+                log("Writing derived variables of selected events to .npy files");
+            if (Sampling())
+                log("Sampling clusters until every cutflow efficiency is known to " + to_string(100*samplePrecision) + "%");
+
             log("SVJ object created");
             end();
             logt();
             log();
         }
 
+        // tag of the quiet constructor below
+        struct InheritSettings {};
+
+        // quiet constructor for worker and per-sample cores; these inherit the settings (not the
+        // chain, collections or results) of the core built from argv and never write to the
+        // terminal. cores own files, histograms and output, so they are never copied
+        SVJFinder(InheritSettings, const SVJFinder & config, string sample="") : sample(sample), inputspec(config.inputspec), outputdir(config.outputdir), saveCuts(config.saveCuts), variationSpec(config.variationSpec), scanSpec(config.scanSpec), chunkSize(config.chunkSize), sketchSize(config.sketchSize), npy(config.npy), constituentDR(config.constituentDR), reclusterRadii(config.reclusterRadii), reclusterAlgorithm(config.reclusterAlgorithm), reclusterPtMin(config.reclusterPtMin), zoneDir(config.zoneDir) {
+            tStart(programstart); 
+            debug = false;
+            timing = false;
+            quiet = true; 
+        }
+
+        SVJFinder(const SVJFinder &) = delete;
+        SVJFinder & operator=(const SVJFinder &) = delete;
+
+        // quiet constructor for in-process use (see SelectionSession.h), over all entries of the
+        // files listed in inputspec
+        SVJFinder(string inputspec, string sample, string outputdir) : sample(sample), inputspec(inputspec), outputdir(outputdir) {
+            tStart(programstart); 
+            nMin = 0;
+            nMax = -1;
+            debug = false;
+            timing = false;
+            quiet = true; 
+        }
+
         // destructor for dynamically allocated data
         ~SVJFinder() {
             start();
 
-            Debug(true); 
+            Debug(!quiet); 
             log();
             logp("Quitting; cleaning up class variables...  ");
             
-            DelVector(varValues);
-            DelVector(vectorVarValues);
-            DelVector(LorentzVectors);
-            DelVector(MockVectors);
-            DelVector(MapVectors);
-            DelVector(hists);
-            delete chain;
-            chain = nullptr; 
-            file->Close();
+            DelVector(collections);
+            DelVector(retired);
+            for (size_t v = 0; v < variations.size(); ++v)
+                DelVector(variations[v].hists);
+            CloseFiles();
+            if (file)
+                file->Close();
             file = nullptr; 
             logr("Success");
             end();
@@ -165,10 +507,6 @@ public:
             logr("s");
 
             log(); 
-            // DelVector(varLeaves);
-            // DelVector(vectorVarLeaves);
-            // for (vector<TLeaf*> vec : compVectors) 
-            //     DelVector(vec);
         }
 
     /// FILE HANDLERS
@@ -194,11 +532,25 @@ public:
             start();
             log("Creating file chain with tree type 'Delphes'...");
             chain = new ParallelTreeChain();
+            if (stageDir.size() > 0) {
+                ownedStaging.reset(new StagingCache(stageDir, stageSize));
+                staging = ownedStaging.get();
+                std::ifstream list(inputspec.c_str());
+                vector<string> filenames;
+                string s;
+                while (getline(list, s))
+                    if (s.size() > 0)
+                        filenames.push_back(s);
+                staging->Prefetch(filenames);
+                chain->SetStaging(staging);
+            }
             outputTrees = chain->GetTrees(inputspec, "Delphes");
 
-            selectionIndex.resize(outputTrees.size());
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].selectionIndex.resize(outputTrees.size());
+            treeFound.assign(outputTrees.size(), true);
 
-            file = new TFile((outputdir + "/" + sample + "_output.root").c_str(), "RECREATE");
+            MakeOutput();
             nEvents = (Int_t)chain->GetEntries();
 
             if (nMax < 0 || nMax > nEvents)
@@ -211,216 +563,492 @@ public:
             return chain;
         }
 
+        // replaces the chain with one over the given files; results keep accumulating until Export
+        ParallelTreeChain* OpenFiles(const vector<string> & filenames) {
+            CloseFiles();
+            chain = new ParallelTreeChain();
+            chain->SetStaging(staging);
+            vector<string> opened = chain->GetTrees(filenames, "Delphes");
+            treeOffset = outputTrees.size();
+            outputTrees.insert(outputTrees.end(), opened.begin(), opened.end());
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].selectionIndex.resize(outputTrees.size());
+            treeFound.resize(outputTrees.size(), true);
+            boundTree = -1;
+            nEvents = (Int_t)chain->GetEntries();
+            nMin = 0;
+            nMax = nEvents;
+            return chain;
+        }
+
+        // makes a single input file current. the file stays open, with its own chain, so later
+        // entry ranges of it need no reopening; the least recently used files are closed beyond
+        // MAX_OPEN_FILES. results keep accumulating until Export
+        ParallelTreeChain* UseFile(const string & filename) {
+            auto it = std::find_if(openFiles.begin(), openFiles.end(), [&filename](const std::pair<string, ParallelTreeChain*> & f) { return f.first == filename; });
+            if (it == openFiles.end()) {
+                if (openFiles.empty())
+                    CloseFiles();
+                if (openFiles.size() >= MAX_OPEN_FILES) {
+                    delete openFiles.back().second;
+                    openFiles.pop_back();
+                }
+                ParallelTreeChain* opened = new ParallelTreeChain();
+                opened->SetStaging(staging);
+                opened->GetTrees(vector<string>(1, filename), "Delphes");
+                openFiles.insert(openFiles.begin(), std::make_pair(filename, opened));
+            }
+            else {
+                std::rotate(openFiles.begin(), it, it + 1);
+            }
+
+            if (chain != openFiles.front().second)
+                boundTree = -1;
+            chain = openFiles.front().second;
+
+            // a file without a delphes tree has no entries, and gets no output row
+            if (chain->size() > 0) {
+                treeOffset = std::find(outputTrees.begin(), outputTrees.end(), filename) - outputTrees.begin();
+                if (treeOffset == outputTrees.size()) {
+                    outputTrees.push_back(filename);
+                    for (size_t v = 0; v < variations.size(); ++v)
+                        variations[v].selectionIndex.resize(outputTrees.size());
+                    treeFound.resize(outputTrees.size(), true);
+                }
+            }
+            nEvents = (Int_t)chain->GetEntries();
+            nMin = 0;
+            nMax = nEvents;
+            return chain;
+        }
+
+        // closes the chain and every file kept open by UseFile
+        void CloseFiles() {
+            bool shared = false;
+            for (size_t i = 0; i < openFiles.size(); ++i) {
+                shared = shared || openFiles[i].second == chain;
+                delete openFiles[i].second;
+            }
+            if (!shared)
+                delete chain;
+            openFiles.clear();
+            chain = nullptr;
+            boundTree = -1;
+        }
+
+        // opens the output file of this sample
+        TFile* MakeOutput() {
+            file = new TFile((outputdir + "/" + sample + "_output.root").c_str(), "RECREATE");
+            return file;
+        }
+
+        // writes out and closes the output file, for cores which run again after their outputs
+        // are written (see SelectionService.h)
+        void CloseOutput() {
+            if (file) {
+                file->Close();
+                delete file;
+            }
+            file = nullptr;
+        }
+
+        // output directory of variation i; the nominal results sit at the top of the output file
+        TDirectory* OutputDirectory(size_t i) {
+            if (i == 0)
+                return file;
+            TDirectory* d = file->GetDirectory(variations[i].name.c_str());
+            return d ? d : file->mkdir(variations[i].name.c_str());
+        }
+
+        // text output path of variation i, e.g. <outputdir>/<sample>_<variation>_cutflow.txt
+        string OutputName(size_t i, string suffix) {
+            return outputdir + "/" + sample + (i == 0 ? "" : "_" + variations[i].name) + suffix;
+        }
+
+        // declares the input files of a sample whose results arrive through Merge, in output order
+        void ExpectTrees(const vector<string> & filenames) {
+            outputTrees = filenames;
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].selectionIndex.assign(outputTrees.size(), vector<size_t>());
+            treeFound.assign(outputTrees.size(), false);
+            for (size_t i = 0; i < outputTrees.size(); ++i)
+                treeSlot[outputTrees[i]] = i;
+        }
+
+        // adds one more expected input file, for inputs which only become known as they arrive
+        void ExpectTree(const string & filename) {
+            if (treeSlot.count(filename))
+                return;
+            treeSlot[filename] = outputTrees.size();
+            outputTrees.push_back(filename);
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].selectionIndex.resize(outputTrees.size());
+            treeFound.push_back(false);
+        }
+
     /// VARIABLE TRACKER FUNCTIONS
     ///
 
-        // creates, assigns, and returns tlorentz vector pointer to be updated on GetEntry
-        vector<TLorentzVector>* AddLorentz(string vectorName, vector<string> components) {
+        // creates, registers, and returns the values of a typed collection, updated on GetEntry.
+        // the collection type fixes the element type and the storage type of every component
+        template<typename collection>
+        typename collection::Values* AddCollection(string vectorName, typename collection::Components components) {
             start();
-            assert(components.size() == 4);
-            AddCompsBase(vectorName, components);
-            size_t i = LorentzVectors.size();
-            subIndex.push_back(std::make_pair(i, vectorType::Lorentz));
-            vector<TLorentzVector>* ret = new vector<TLorentzVector>; 
-            LorentzVectors.push_back(ret);
+            logp("Adding " + to_string(collection::N) + " components to vector " + vectorName + "...  ");
+            collection* c = Registered<collection>(vectorName);
+            if (c == nullptr) {
+                c = new collection(vectorName, components);
+                AddCollectionBase(c);
+            }
             logr("Success");
             end();
             logt();
-            return ret;
+            return c->Get();
+        }
+
+        // creates, assigns, and returns tlorentz vector pointer to be updated on GetEntry
+        vector<TLorentzVector>* AddLorentz(string vectorName, Collections::Lorentz::Components components) {
+            return AddCollection<Collections::Lorentz>(vectorName, components);
         }
 
         // creates, assigns, and returns mock tlorentz vector pointer to be updated on GetEntry
-        vector<TLorentzMock>* AddLorentzMock(string vectorName, vector<string> components) {
-            start();
-            assert(components.size() > 1 && components.size() < 5);
-            AddCompsBase(vectorName, components);
-            size_t i = MockVectors.size();
-            subIndex.push_back(std::make_pair(i, vectorType::Mock));
-            vector<TLorentzMock>* ret = new vector<TLorentzMock>; 
-            MockVectors.push_back(ret);
-            logr("Success");
-            end();
-            logt();
-            return ret;
+        template<typename... storage>
+        vector<TLorentzMock>* AddLorentzMock(string vectorName, typename Collections::Mock<storage...>::Components components) {
+            static_assert(sizeof...(storage) > 1 && sizeof...(storage) < 5, "TLorentzMock takes 2 to 4 components");
+            return AddCollection<Collections::Mock<storage...>>(vectorName, components);
         }
 
         // creates, assigns, and returns general double vector pointer to be updated on GetEntry
-        vector<vector<double>>* AddComps(string vectorName, vector<string> components) {
-            start(); 
-            AddCompsBase(vectorName, components);
-            size_t i = MapVectors.size();
-            subIndex.push_back(std::make_pair(i, vectorType::Map));
-            vector<vector<double>>* ret = new vector<vector<double>>;
-            MapVectors.push_back(ret);
-            logr("Success");
-            end();
-            logt();
-            return ret;
+        template<typename... storage>
+        vector<vector<double>>* AddComps(string vectorName, typename Collections::Map<storage...>::Components components) {
+            return AddCollection<Collections::Map<storage...>>(vectorName, components);
         }
 
         // creates, assigns, and returns a vectorized single variable pointer to be updates on GetEntry
+        template<typename storage=Float_t>
         vector<double>* AddVectorVar(string vectorVarName, string component) {
-            start();
-            logp("Adding 1 component to vector var " + vectorVarName + "...  ");
-            int i = int(vectorVarValues.size());
-            vectorVarIndex[vectorVarName] = i;
-            vectorVarLeaves.push_back(chain->FindLeaf(component));
-            vector<double>* ret = new vector<double>;
-            vectorVarValues.push_back(ret);
-            logr("Success");
-            end();
-            logt();
-            // log(vectorVarIndex.size());
-            // log(vectorVarValues.back().size());
-            // log(i);
-            return ret;
+            return AddCollection<Collections::VectorVar<storage>>(vectorVarName, {component});
         }
 
         // creates, assigns, and returns a singular double variable pointer to update on GetEntry 
+        template<typename storage=Float_t>
         double* AddVar(string varName, string component) {
             start();
             logp("Adding 1 component to var " + varName + "...  ");
-            size_t i = varLeaves.size();
-            varIndex[varName] = i;
-            double* ret = new double;
-            varLeaves.push_back(chain->FindLeaf(component));
-            varValues.push_back(ret);
+            Collections::Scalar<storage>* c = Registered<Collections::Scalar<storage>>(varName);
+            if (c == nullptr) {
+                c = new Collections::Scalar<storage>(varName, component);
+                AddCollectionBase(c);
+            }
             logr("Success");
             end();
             logt(); 
-            return ret;
+            return c->Get();
         }
 
-    /// ENTRY LOADING
-    ///
-
-        void reloadLeaves() {
+        // creates, assigns, and returns the EFlow objects of each entry. these are only read for
+        // entries which ask for them with LoadLate, e.g. selected events
+        vector<TLorentzVector>* AddEFlow(string vectorName) {
+            start();
+            logp("Adding EFlow objects to vector " + vectorName + "...  ");
+            Collections::EFlow* c = Registered<Collections::EFlow>(vectorName);
+            if (c == nullptr) {
+                c = new Collections::EFlow(vectorName);
+                AddCollectionBase(c);
+            }
+            c->stage = 3;
+            logr("Success");
+            end();
+            logt();
+            return c->Get();
+        }
 
+        // creates, assigns, and returns jets reclustered from the objects of AddEFlow at each
+        // radius, as AddLorentz does for the delphes jets. clustered on LoadLate, like their input
+        vector<vector<TLorentzVector>*> AddReclustered(string vectorName, const vector<TLorentzVector>* constituents, vector<double> radii, JetClustering::Algorithm algorithm=JetClustering::antikt, double ptMin=0.) {
+            start();
+            logp("Adding " + to_string(radii.size()) + " reclustered jet radii to vector " + vectorName + "...  ");
+            Collections::Reclustered* c = Registered<Collections::Reclustered>(vectorName);
+            if (c == nullptr) {
+                c = new Collections::Reclustered(vectorName, constituents, radii, algorithm, ptMin);
+                AddCollectionBase(c);
+            }
+            c->stage = 3;
+            logr("Success");
+            end();
+            logt();
+            return c->Get();
         }
 
-        // get the ith entry of the TChain
+    /// ENTRY LOADING
+    ///
+
+        // get the ith entry of the TChain. collections of stage 1 are read for every entry; those
+        // of stage 2 only if the preselection, evaluated on stage 1, passes, and are left empty
+        // otherwise. only the branches of read collections are decompressed. collections of
+        // stage 3 stay empty until LoadLate
         void GetEntry(int entry = 0) {
             assert(entry < chain->GetEntries());
+            // a single writer, so no locked increment is needed
+            entriesRead.store(entriesRead.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            // between entries, so a snapshot never holds half an event
+            if (livePath.size() > 0 && ++liveEntries % LIVE_CHECK_ENTRIES == 0)
+                PublishLive();
             logp("Getting entry " + to_string(entry) + "...  ");
-	        int treeId = chain->GetEntry(entry);
+	        int treeId = chain->Seek(entry);
             currentEntry = entry;
-            if (chain->currentEntry == 0) {
+            if (chain->currentEntry == 0 && !quiet) {
                 bool last = debug;
                 Debug(true);
                 logp("");
                 Debug(last);
                 cout << "Processing tree " << chain->currentTree + 1 << " of " << chain->size() << endl;
             }
-            for (size_t i = 0; i < subIndex.size(); ++i) {
-                switch(subIndex[i].second) {
-                    case vectorType::Lorentz: {
-                        SetLorentz(i, subIndex[i].first, treeId);
-                        break;
-                    }
-                    case vectorType::Mock: {
-                        SetMock(i, subIndex[i].first, treeId);
-                        break;
-                    }
-                    case vectorType::Map: {
-                        SetMap(i, subIndex[i].first, treeId);
-                        break;
-                    }
-                }
-            }
 
-            for (size_t i = 0; i < varValues.size(); ++i) {
-                SetVar(i, treeId);
+            // leaves are only resolved when the chain moves on to a new tree
+            if (treeId != boundTree) {
+                layout.Use(chain->GetTree(treeId), chain->Fingerprint(treeId));
+                for (size_t i = 0; i < collections.size(); ++i)
+                    collections[i]->Bind(layout);
+                boundTree = treeId;
             }
 
-            for (size_t i = 0; i < vectorVarValues.size(); ++i) {
-                SetVectorVar(i, treeId);
+            for (size_t i = 0; i < collections.size(); ++i) {
+                if (collections[i]->stage == 1) {
+                    collections[i]->Read(chain->currentEntry);
+                    collections[i]->Load();
+                }
+            }
+            fullEntry = !preselection || preselection();
+            lateLoaded = false;
+            for (size_t i = 0; i < collections.size(); ++i) {
+                if (collections[i]->stage == 1)
+                    continue;
+                if (fullEntry && collections[i]->stage == 2) {
+                    collections[i]->Read(chain->currentEntry);
+                    collections[i]->Load();
+                }
+                else {
+                    collections[i]->Clear();
+                }
             }
-            // cout << vectorVarValues.size() << endl;
-            // for (size_t i = 0; i < vectorVarValues.size(); ++i) {
-            //     cout << i << " | "; 
-            //     for (size_t j = 0; j < vectorVarValues[i].size(); ++j) {
-            //         cout << j << ": " << vectorVarValues[i][j] << ", ";
-            //     }
-            //     cout << endl; 
-            // }
+
             logr("Success");
         }
 
+        // collections registered after this are read in the given stage (1 or 2)
+        void LoadInStage(int stage) {
+            loadStage = stage;
+        }
+
+        // reads the stage 3 collections of the current entry, once
+        void LoadLate() {
+            if (lateLoaded)
+                return;
+            for (size_t i = 0; i < collections.size(); ++i) {
+                if (collections[i]->stage == 3) {
+                    collections[i]->Read(chain->currentEntry);
+                    collections[i]->Load();
+                }
+            }
+            lateLoaded = true;
+        }
+
+        // decides from the stage 1 collections whether the stage 2 collections of an entry are
+        // needed. without one, every collection is read
+        void SetPreselection(std::function<bool()> predicate) {
+            preselection = predicate;
+        }
+
+        // true if the stage 2 collections of the current entry were read
+        bool FullEntry() {
+            return fullEntry;
+        }
+
         // get the number of entries in the TChain
         Int_t GetEntries() {
             return nEvents;
         }
 
+    /// VARIATIONS
+    ///
+
+        // adds a named variation of the selection, with its own cutflow, histograms and selection
+        // index. all variations are evaluated on the same decoded entry; variation 0 is the nominal
+        // selection. variations have to be added before any histogram
+        size_t AddVariation(string name) {
+            assert(variations[0].hists.empty());
+            for (size_t i = 0; i < variations.size(); ++i)
+                if (variations[i].name == name)
+                    throw "Variation '" + name + "' already exists!";
+            variations.push_back(Variation(name));
+            variations.back().selectionIndex.resize(outputTrees.size());
+            variations.back().scan.resize(variations[0].scan.size());
+            return variations.size() - 1;
+        }
+
+        // directs Cut, Fill and the selection index to the results of variation i
+        void SetVariation(size_t i) {
+            active = i;
+        }
+
+        size_t NVariations() {
+            return variations.size();
+        }
+
     /// CUTS
     ///
 
         bool Cut(bool expression, Cuts::CutType cutName) {
-            cutValues[cutName] = expression ? 1 : 0;
+            variations[active].cutValues[cutName] = expression ? 1 : 0;
             return expression;
         }
 
+        // also records the value of the variable the cut is made on, for its N-1 histogram
+        bool Cut(bool expression, Cuts::CutType cutName, double value) {
+            variations[active].cutVariables[cutName] = value;
+            return Cut(expression, cutName);
+        }
+
         bool Cut(Cuts::CutType cutName) {
-            return cutValues[cutName]; 
+            return variations[active].cutValues[cutName]; 
         }
 
         bool CutsRange(int start, int end) {
+            vector<int> & cutValues = variations[active].cutValues;
             return std::all_of(cutValues.begin() + start, cutValues.begin() + end, [](int i){return i > 0;});
         }
 
+        // describes how a cut of variation v is made, for zone maps: the settings its variable
+        // depends on, and whether it passes above ('>') or below ('<') the threshold. cuts without
+        // a threshold ('-') are taken to be decided by the cuts before them; undescribed cuts
+        // never let a zone be skipped
+        void DescribeCut(size_t v, Cuts::CutType cutName, string variable, char op='-', double threshold=0) {
+            ZoneMap::Rule & rule = variations[v].rules[cutName];
+            rule.variable = variable;
+            rule.op = op;
+            rule.threshold = threshold;
+        }
+
         void InitCuts() {
+            vector<int> & cutValues = variations[active].cutValues;
             std::fill(cutValues.begin(), cutValues.end(), -1);
+            vector<double> & cutVariables = variations[active].cutVariables;
+            std::fill(cutVariables.begin(), cutVariables.end(), NAN);
         }
 
         void PrintCuts() {
-            print(&cutValues);
+            print(&variations[active].cutValues);
         }
 
         void UpdateCutFlow() {
+            vector<int> & cutValues = variations[active].cutValues;
+            vector<int> & CutFlow = variations[active].CutFlow;
             size_t i = 0;
             CutFlow[0]++; 
             while (i < cutValues.size() && cutValues[i] > 0)
                 CutFlow[++i]++;
+            FillNMinusOne();
         }
 
-        void PrintCutFlow() {
-            int fn = 20;
-            int ns = 6 + int(log10(CutFlow[0]));
-            int n = 10;
+        // adds an N-1 histogram for a cut: its variable, for events passing every other cut which
+        // has one, except the cuts given as sameVariable, which cut the same variable and would
+        // hide the effect of this one. composite cuts, which have no variable of their own, get
+        // none and are left out. the histograms sit with the others, next to h_CutFlow
+        void AddNMinusOne(Cuts::CutType cutName, string name, string title, int bins, double min, double max, vector<Cuts::CutType> sameVariable={}) {
+            nMinusOneIndex[cutName] = AddHist(name, title, bins, min, max);
+            nMinusOneCuts |= 1u << cutName;
+            for (size_t i = 0; i < sameVariable.size(); ++i)
+                nMinusOneIgnored[cutName] |= 1u << sameVariable[i];
+        }
 
-            log(); 
-            cout << std::setprecision(2) << std::fixed;
-            cout << LOG_PREFIX << setw(fn) << "CutFlow" << setw(ns) << "N" << setw(n) << "Abs Eff" << setw(n) << "Rel Eff" << endl;
-            cout << LOG_PREFIX << string(fn + ns + n*2, '=') << endl;
-            cout << LOG_PREFIX << setw(fn) << "None" << setw(ns) << CutFlow[0] << setw(n) << 100.0 << setw(n) << 100.0 << endl;
+        void PrintCutFlow() {
+            for (size_t v = 0; v < variations.size(); ++v) {
+                vector<int> & CutFlow = variations[v].CutFlow;
+                int fn = 20;
+                int ns = 6 + int(log10(CutFlow[0]));
+                int n = 10;
+
+                log(); 
+                if (variations.size() > 1)
+                    cout << LOG_PREFIX << "Variation: " << variations[v].name << endl;
+                cout << std::setprecision(2) << std::fixed;
+                int nc = Sampling() ? 2 : 0;
+                cout << LOG_PREFIX << setw(fn) << "CutFlow" << setw(ns) << "N" << setw(n) << "Abs Eff" << setw(n) << "Rel Eff";
+                if (Sampling())
+                    cout << setw(n) << "+- Abs" << setw(n) << "+- Rel";
+                cout << endl;
+                cout << LOG_PREFIX << string(fn + ns + n*(2 + nc), '=') << endl;
+                cout << LOG_PREFIX << setw(fn) << "None" << setw(ns) << CutFlow[0] << setw(n) << 100.0 << setw(n) << 100.0 << endl;
 
-            int i = 1;
-            for (auto elt : Cuts::CutName) {
-                cout << LOG_PREFIX << std::setw(fn) << elt.second << std::setw(ns) << CutFlow[i] << std::setw(n) << 100.*float(CutFlow[i])/float(CutFlow[0]) << std::setw(n) << 100.*float(CutFlow[i])/float(CutFlow[i - 1]) << endl;
-                i++;
+                int i = 1;
+                for (auto elt : Cuts::CutName) {
+                    cout << LOG_PREFIX << std::setw(fn) << elt.second << std::setw(ns) << CutFlow[i] << std::setw(n) << 100.*float(CutFlow[i])/float(CutFlow[0]) << std::setw(n) << 100.*float(CutFlow[i])/float(CutFlow[i - 1]);
+                    if (Sampling()) {
+                        pair<double, double> abs = Interval(v, i, false), rel = Interval(v, i, true);
+                        cout << std::setw(n) << 50.*(abs.second - abs.first) << std::setw(n) << 50.*(rel.second - rel.first);
+                    }
+                    cout << endl;
+                    i++;
+                }
+                if (Sampling())
+                    log("Sampled " + to_string(sampled) + " of " + to_string(nMax - nMin) + " entries; intervals at " + to_string(100*SAMPLE_CONFIDENCE) + "% confidence");
             }
+            if (zoneDir.size() > 0)
+                log("Skipped " + to_string(zoneSkipped) + " entries by zone maps");
+            if (zoneSkipped > 0)
+                log("WARNING :: entries skipped by zone maps are only in the cutflow; the pre-cut and N-1 histograms, sketches and columns hold the entries read");
         }
 
         void SaveCutFlow() {
-            TH1F *CutFlowHist = new TH1F("h_CutFlow","CutFlow", Cuts::CutName.size(), -0.5, Cuts::CutName.size() - 0.5);
-            CutFlowHist->SetBinContent(1, CutFlow[0]);
-            CutFlowHist->GetXaxis()->SetBinLabel(1, "no selection");
-            int i = 1;
-            for (auto elt : Cuts::CutName) {
-                CutFlowHist->SetBinContent(i + 1, CutFlow[elt.first]);
-                CutFlowHist->GetXaxis()->SetBinLabel(i + 1, elt.second.c_str());
-                i++;
-            }
-            CutFlowHist->Write(); 
-
-            std::ofstream f(outputdir + "/" + sample + "_cutflow.txt");
-            if (f.is_open()) {
-                vector<string> cutNames;
+            for (size_t v = 0; v < variations.size(); ++v) {
+                vector<int> & CutFlow = variations[v].CutFlow;
+                OutputDirectory(v)->cd();
+                TH1F *CutFlowHist = new TH1F("h_CutFlow","CutFlow", Cuts::CutName.size(), -0.5, Cuts::CutName.size() - 0.5);
+                CutFlowHist->SetBinContent(1, CutFlow[0]);
+                CutFlowHist->GetXaxis()->SetBinLabel(1, "no selection");
+                int i = 1;
                 for (auto elt : Cuts::CutName) {
-                    cutNames.push_back(elt.second);
+                    CutFlowHist->SetBinContent(i + 1, CutFlow[elt.first]);
+                    CutFlowHist->GetXaxis()->SetBinLabel(i + 1, elt.second.c_str());
+                    i++;
+                }
+                // the counts as run, like _cutflow.txt; a sampled run also writes the estimate
+                // for the whole range, scaled like the other histograms
+                CutFlowHist->Write(); 
+                if (Sampling()) {
+                    TH1F* scaled = (TH1F*)CutFlowHist->Clone("h_CutFlow_scaled");
+                    scaled->SetTitle("CutFlow, scaled to the whole range");
+                    scaled->Scale(sampleScale);
+                    scaled->Write();
+                }
+
+                std::ofstream f(OutputName(v, "_cutflow.txt"));
+                if (f.is_open()) {
+                    vector<string> cutNames;
+                    for (auto elt : Cuts::CutName) {
+                        cutNames.push_back(elt.second);
+                    }
+                    WriteVector(f, CutFlow);
+                    WriteVector(f, cutNames);
+                    // sampled runs add the entries run and the entries in range, then the low and
+                    // high ends of the absolute, then the relative, efficiency interval of each cut
+                    if (Sampling()) {
+                        vector<Long64_t> entries = {sampled, Long64_t(nMax - nMin)};
+                        WriteVector(f, entries);
+                        for (int relative = 0; relative < 2; ++relative) {
+                            vector<double> low, high;
+                            for (size_t c = 1; c < CutFlow.size(); ++c) {
+                                pair<double, double> ci = Interval(v, c, relative);
+                                low.push_back(ci.first);
+                                high.push_back(ci.second);
+                            }
+                            WriteVector(f, low);
+                            WriteVector(f, high);
+                        }
+                    }
+                    f.close();
                 }
-                WriteVector(f, CutFlow);
-                WriteVector(f, cutNames);
-                f.close();
             }
         }
 
@@ -438,110 +1066,718 @@ public:
         //         print(&savedCuts[i]); 
         // }
 
+    /// SAMPLING
+    ///
+
+        bool Sampling() {
+            return samplePrecision > 0;
+        }
+
+        // cluster-sized entry ranges of [nMin, nMax) in random order, so the entries run before
+        // stopping are a fair sample of the whole range while still being read cluster by cluster.
+        // the order is seeded, so sampled runs are reproducible
+        vector<pair<Int_t, Int_t>> SampleRanges() {
+            vector<pair<Int_t, Int_t>> ranges;
+            Long64_t offset = 0;
+            for (size_t t = 0; t < chain->size(); ++t) {
+                TTree* tree = chain->GetTree(t);
+                Long64_t n = tree->GetEntries();
+                TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+                Long64_t start;
+                while ((start = clusters()) < n) {
+                    Long64_t end = std::min(clusters.GetNextEntry(), n);
+                    Long64_t first = std::max(offset + start, (Long64_t)nMin), last = std::min(offset + end, (Long64_t)nMax);
+                    if (first < last)
+                        ranges.push_back(pair<Int_t, Int_t>(Int_t(first), Int_t(last)));
+                }
+                offset += n;
+            }
+            std::mt19937 random(SAMPLE_SEED);
+            std::shuffle(ranges.begin(), ranges.end(), random);
+            return ranges;
+        }
+
+        // Wilson interval of the absolute (or relative to the cut before) efficiency of cut i of
+        // variation v, where cut 0 is no selection
+        pair<double, double> Interval(size_t v, size_t i, bool relative) {
+            const vector<int> & CutFlow = variations[v].CutFlow;
+            double total = relative ? CutFlow[i - 1] : CutFlow[0];
+            return pair<double, double>(TEfficiency::Wilson(total, CutFlow[i], SAMPLE_CONFIDENCE, false), TEfficiency::Wilson(total, CutFlow[i], SAMPLE_CONFIDENCE, true));
+        }
+
+        // true once the interval of every absolute and relative efficiency, in every variation, is
+        // narrower than samplePrecision of the efficiency. efficiencies of zero never are, so a
+        // cut nothing has passed yet keeps the sample growing
+        bool Precise() {
+            if (sampled < MIN_SAMPLE_ENTRIES)
+                return false;
+            for (size_t v = 0; v < variations.size(); ++v) {
+                const vector<int> & CutFlow = variations[v].CutFlow;
+                for (size_t i = 1; i < CutFlow.size(); ++i) {
+                    for (int relative = 0; relative < 2; ++relative) {
+                        double total = relative ? CutFlow[i - 1] : CutFlow[0];
+                        pair<double, double> ci = Interval(v, i, relative);
+                        if (CutFlow[i] == 0 || (ci.second - ci.first)/2 > samplePrecision*CutFlow[i]/total)
+                            return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // scales the histograms of a sampled run up to the whole entry range. the cutflow counts
+        // and the scan stay in sampled events, as their intervals and efficiencies are based on
+        // them; h_CutFlow is scaled when written
+        void ScaleSample() {
+            if (!Sampling() || sampled <= 0)
+                return;
+            sampleScale = double(nMax - nMin)/sampled;
+            for (size_t v = 0; v < variations.size(); ++v)
+                for (size_t i = 0; i < variations[v].hists.size(); ++i)
+                    variations[v].hists[i]->Scale(sampleScale);
+        }
+
+    /// ZONE MAPS
+    ///
+
+        // runs the entries [first, last) of the chain through the selection. with zone maps
+        // (--zones, see ZoneMap.h), a file with a map has its clusters skipped where no event passes
+        // some cut in any variation, their events counted in the cutflow up to that cut from the
+        // map. a file without one gets one from the runs over it, whole or range by range (see
+        // ZoneMap::StorePiece), so split and distributed runs build maps too. skipped events fill
+        // no histograms or sketches, so those booked before the skipping cut (pre-cut and N-1)
+        // only hold the events read, which the cutflow printout warns of. a scan needs every
+        // event, and turns skipping off
+        template<typename analysis>
+        void ProcessRange(analysis & selection, Long64_t first, Long64_t last) {
+            if (zoneDir.empty()) {
+                for (Long64_t entry = first; entry < last; ++entry)
+                    selection.Process(Int_t(entry));
+                return;
+            }
+            if (!zones)
+                zones.reset(new ZoneMap(zoneDir, SELECTION_VERSION));
+            Long64_t offset = 0;
+            for (size_t t = 0; t < chain->size() && offset < last; ++t) {
+                Long64_t n = chain->GetTree(t)->GetEntries();
+                Long64_t a = std::max(first, offset), b = std::min(last, offset + n);
+                if (a < b)
+                    ProcessZones(selection, t, offset, n, a, b);
+                offset += n;
+            }
+        }
+
+        // the part [a, b) of tree t of the chain, whose n entries start at offset
+        template<typename analysis>
+        void ProcessZones(analysis & selection, size_t t, Long64_t offset, Long64_t n, Long64_t a, Long64_t b) {
+            const string & filename = outputTrees[treeOffset + t];
+            ZoneMap::File map;
+            if (zones->Load(filename, map) && map.entries == n && map.rules.size() == Cuts::COUNT) {
+                if (a == offset && b == offset + n && SkipZone(map.total, map.rules))
+                    return;
+                // zones only partly in range are run, as their cutflow is for the whole zone
+                for (size_t z = 0; z < map.zones.size(); ++z) {
+                    const ZoneMap::Zone & zone = map.zones[z];
+                    Long64_t first = std::max(a, offset + zone.first), last = std::min(b, offset + zone.last);
+                    if (first >= last)
+                        continue;
+                    if (first == offset + zone.first && last == offset + zone.last && SkipZone(zone, map.rules))
+                        continue;
+                    for (Long64_t entry = first; entry < last; ++entry)
+                        selection.Process(Int_t(entry));
+                }
+                return;
+            }
+
+            // a file without a map: run cluster by cluster, keeping the range of every cut variable
+            // and the cutflow of the nominal selection in each. the clusters at the ends of a
+            // range are cut to the range
+            map = ZoneMap::File();
+            map.entries = n;
+            map.rules = variations[0].rules;
+            // boundaries first: the chain may switch the tree to a staged copy once it is read
+            vector<Long64_t> ends;
+            TTree::TClusterIterator clusters = chain->GetTree(t)->GetClusterIterator(a - offset);
+            while (clusters() < b - offset)
+                ends.push_back(std::min(clusters.GetNextEntry(), b - offset));
+            for (size_t c = 0; c < ends.size(); ++c) {
+                ZoneMap::Zone zone(Cuts::COUNT);
+                zone.first = c == 0 ? a - offset : ends[c - 1];
+                zone.last = ends[c];
+                vector<int> before = variations[0].CutFlow;
+                for (Long64_t entry = zone.first; entry < zone.last; ++entry) {
+                    selection.Process(Int_t(offset + entry));
+                    for (size_t i = 0; i < Cuts::COUNT; ++i)
+                        zone.Add(i, variations[0].cutVariables[i]);
+                }
+                for (size_t i = 0; i < zone.cutflow.size(); ++i)
+                    zone.cutflow[i] = variations[0].CutFlow[i] - before[i];
+                map.zones.push_back(zone);
+            }
+            if (a == offset && b == offset + n)
+                zones->Store(filename, map);
+            else
+                zones->StorePiece(filename, map);
+        }
+
+        // if, in every variation, no event of the zone can pass some cut, counts the zone's events
+        // in each cutflow up to the first such cut and returns true. a cut only counts if the run
+        // which made the map evaluated its variable, and every cut before it, the same way
+        bool SkipZone(const ZoneMap::Zone & zone, const vector<ZoneMap::Rule> & rules) {
+            if (Scanning())
+                return false;
+            vector<size_t> failing(variations.size());
+            for (size_t v = 0; v < variations.size(); ++v) {
+                const vector<ZoneMap::Rule> & own = variations[v].rules;
+                size_t k = 0;
+                for (; k < Cuts::COUNT; ++k) {
+                    if (own[k].op != '-' && own[k].op == rules[k].op && own[k].variable == rules[k].variable && zone.Fails(k, own[k]))
+                        break;
+                    if (!(own[k] == rules[k]))
+                        return false;
+                }
+                if (k == Cuts::COUNT)
+                    return false;
+                failing[v] = k;
+            }
+            for (size_t v = 0; v < variations.size(); ++v)
+                for (size_t i = 0; i <= failing[v]; ++i)
+                    variations[v].CutFlow[i] += zone.cutflow[i];
+            zoneSkipped += zone.last - zone.first;
+            return true;
+        }
+
+    /// LIVE SNAPSHOT
+    ///
+
+        // publishes the cutflow and histograms of every variation, and the progress of the run, to
+        // the live snapshot (--live, see LiveSnapshot.h). runs at most every LIVE_INTERVAL seconds
+        // while the run goes on; the snapshot of a finished run stays until the next run
+        void PublishLive(bool finished=false) {
+            if (livePath.empty())
+                return;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            double since = std::chrono::duration<double>(now - liveLast).count();
+            if (live && !finished && since < LIVE_INTERVAL)
+                return;
+            if (!live) {
+                vector<string> names, cuts;
+                for (size_t v = 0; v < variations.size(); ++v)
+                    names.push_back(variations[v].name);
+                for (auto elt : Cuts::CutName)
+                    cuts.push_back(elt.second);
+                vector<LiveSnapshot::Hist> hists;
+                for (size_t i = 0; i < variations[0].hists.size(); ++i) {
+                    TH1F* h = variations[0].hists[i];
+                    hists.push_back(LiveSnapshot::Hist{h->GetName(), h->GetNbinsX(), h->GetXaxis()->GetXmin(), h->GetXaxis()->GetXmax()});
+                }
+                live.reset(new LiveSnapshot(livePath, names, cuts, hists));
+                liveStart = UnixTime();
+                since = 0;
+            }
+
+            LiveSnapshot::Header & info = live->Info();
+            Long64_t done = variations[0].CutFlow[0];
+            live->Begin();
+            info.rate = since > 0 ? std::max(double(done) - double(info.done), 0.)/since : 0;
+            info.entries = nMax - nMin;
+            info.done = done;
+            info.finished = finished;
+            info.startTime = liveStart;
+            info.updateTime = UnixTime();
+            for (size_t v = 0; v < variations.size(); ++v) {
+                std::copy(variations[v].CutFlow.begin(), variations[v].CutFlow.end(), live->CutFlow(v));
+                double* bins = live->Bins(v);
+                for (size_t i = 0; i < variations[v].hists.size(); ++i) {
+                    TH1F* h = variations[v].hists[i];
+                    for (int b = 0; b < h->GetNbinsX() + 2; ++b)
+                        *bins++ = h->GetBinContent(b);
+                }
+            }
+            live->End();
+            liveLast = now;
+        }
+
     /// HISTOGRAMS
     ///
 
         size_t AddHist(Hists::HistType ht, string name="", string title="", int bins=10, double min=0., double max=1.) {
-            size_t i = hists.size(); 
-            TH1F* newHist = new TH1F(name.c_str(), title.c_str(), bins, min, max);
-            hists.push_back(newHist);
+            size_t i = AddHist(name, title, bins, min, max);
             histIndex[ht] = i;
             return i;
         }
 
         void Fill(Hists::HistType ht, double value) {
-            hists[histIndex[ht]]->Fill(value);
+            variations[active].hists[histIndex[ht]]->Fill(value);
+            if (sketchIndex[ht] >= 0)
+                variations[active].sketches[sketchIndex[ht]].Add(value);
+        }
+
+        // histograms without a Hists::HistType, e.g. one per reclustering radius, filled by the
+        // index AddHist returned
+        size_t AddHist(string name, string title, int bins, double min, double max) {
+            size_t i = variations[0].hists.size();
+            for (size_t v = 0; v < variations.size(); ++v) {
+                TH1F* newHist = new TH1F(name.c_str(), title.c_str(), bins, min, max);
+                newHist->SetDirectory(0);
+                variations[v].hists.push_back(newHist);
+            }
+            return i;
+        }
+
+        void Fill(size_t index, double value) {
+            variations[active].hists[index]->Fill(value);
         }
 
         void WriteHists() {
-            for (size_t i = 0; i < hists.size(); ++i)
-                hists[i]->Write();
+            for (size_t v = 0; v < variations.size(); ++v) {
+                OutputDirectory(v)->cd();
+                for (size_t i = 0; i < variations[v].hists.size(); ++i)
+                    variations[v].hists[i]->Write();
+            }
         }
 
         void UpdateSelectionIndex(size_t entry) {
             chain->GetN(entry);
-            selectionIndex[chain->currentTree].push_back(chain->currentEntry);
+            variations[active].selectionIndex[treeOffset + chain->currentTree].push_back(chain->currentEntry);
+            if (Recording())
+                AddRow(active, pair<size_t, size_t>(treeOffset + chain->currentTree, chain->currentEntry));
         }
 
         void WriteSelectionIndex() {
-            std::ofstream f(outputdir + "/" + sample + "_selection.txt");
-            log(selectionIndex.size());
-            for (auto elt : selectionIndex) {
-                log(elt.size()); 
-            }
-            if (f.is_open()) {
-                for (size_t i = 0; i < selectionIndex.size(); i++){
-                    f << outputTrees[i] << ": ";
-                    for (size_t j = 0; j < selectionIndex[i].size(); j++) {
-                        f << selectionIndex[i][j] << " ";
+            for (size_t v = 0; v < variations.size(); ++v) {
+                vector<vector<size_t>> & selectionIndex = variations[v].selectionIndex;
+                std::ofstream f(OutputName(v, "_selection.txt"));
+                log(selectionIndex.size());
+                for (auto elt : selectionIndex) {
+                    log(elt.size()); 
+                }
+                if (f.is_open()) {
+                    for (size_t i = 0; i < selectionIndex.size(); i++){
+                        if (!treeFound[i])
+                            continue;
+                        // partials of one file may be merged in any order
+                        std::sort(selectionIndex[i].begin(), selectionIndex[i].end());
+                        f << outputTrees[i] << ": ";
+                        for (size_t j = 0; j < selectionIndex[i].size(); j++) {
+                            f << selectionIndex[i][j] << " ";
+                        }
+                        f << endl;
                     }
-                    f << endl;
+                    f.close();
                 }
-                f.close();
+                WriteEntryList(v);
             }
         }
 
-    /// SWITCHES, TIMING, AND LOGGING
+        // writes the selection of variation i as a TEntryList with one sub-list per input tree to
+        // <outputdir>/<sample>[_<variation>]_selection.root, for TTree::SetEntryList and
+        // SelectionReader. call after WriteSelectionIndex has sorted the rows
+        void WriteEntryList(size_t i) {
+            vector<vector<size_t>> & selectionIndex = variations[i].selectionIndex;
+            TFile out(OutputName(i, "_selection.root").c_str(), "RECREATE");
+            TEntryList all("selection", ("selected entries, " + variations[i].name).c_str());
+            all.SetDirectory(0);
+            for (size_t t = 0; t < selectionIndex.size(); ++t) {
+                if (!treeFound[t])
+                    continue;
+                TEntryList tree("selection", "", "Delphes", outputTrees[t].c_str());
+                tree.SetDirectory(0);
+                for (size_t j = 0; j < selectionIndex[t].size(); ++j)
+                    tree.Enter(selectionIndex[t][j]);
+                all.Add(&tree);
+            }
+            out.cd();
+            all.Write();
+            out.Close();
+        }
+
+    /// THRESHOLD SCANS
     ///
 
-        // Turn on or off debug logging with this switch
-        void Debug(bool debugSwitch) {
-            debug = debugSwitch;
+        // one scanned cut; grid points are the lower bin edges, and an event passes a grid point
+        // if its value is at or above it
+        struct ScanAxis {
+            string name;
+            int bins;
+            double min, max;
+        };
+
+        // sets up a grid of thresholds over the given cuts. each variation counts its events in
+        // bins of the scanned values; the yield at every grid point is a cumulative sum of those
+        void AddScan(const vector<ScanAxis> & axes) {
+            assert(scanAxes.empty() && axes.size() > 0);
+            scanAxes = axes;
+            size_t n = 1;
+            for (size_t i = 0; i < axes.size(); ++i) {
+                if (axes[i].bins < 1 || axes[i].max <= axes[i].min)
+                    throw "Invalid binning for scanned cut '" + axes[i].name + "'";
+                n *= axes[i].bins + 2;
+            }
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].scan.assign(n, 0);
         }
 
-        // turn on or off timing logs with this switch (dependent of debug=true)
-        void Timing(bool timingSwitch) {
-            timing=timingSwitch;
+        bool Scanning() {
+            return scanAxes.size() > 0;
         }
 
-        // prints a summary of the current entry
-        void Current() {
-            log();
-            if (varIndex.size() > 0) {
-                log();
-                print("SINGLE VARIABLES:");
+        // records an event passing every cut which is not scanned, with its values of the scanned
+        // cuts (in AddScan order)
+        void FillScan(const vector<double> & values) {
+            size_t index = 0;
+            for (size_t i = scanAxes.size(); i-- > 0;)
+                index = index*(scanAxes[i].bins + 2) + ScanBin(scanAxes[i], values[i]);
+            variations[active].scan[index]++;
+        }
+
+        // writes, per variation, the scanned event counts and the yield and efficiency at every
+        // grid point, as TH2D for two scanned cuts and THnD otherwise
+        void WriteScan() {
+            if (!Scanning())
+                return;
+            for (size_t v = 0; v < variations.size(); ++v) {
+                OutputDirectory(v)->cd();
+                vector<double> yield = variations[v].scan;
+                size_t stride = 1;
+                for (size_t i = 0; i < scanAxes.size(); ++i) {
+                    size_t n = scanAxes[i].bins + 2;
+                    // suffix sum along axis i, starting from the overflow bin, for every line of
+                    // bins which starts at the underflow bin of this axis
+                    for (size_t j = 0; j < yield.size(); ++j) {
+                        if ((j / stride) % n > 0)
+                            continue;
+                        for (size_t b = n - 1; b-- > 0;)
+                            yield[j + b*stride] += yield[j + (b + 1)*stride];
+                    }
+                    stride *= n;
+                }
+                double total = variations[v].CutFlow[0];
+                vector<double> efficiency(yield.size(), 0);
+                for (size_t j = 0; j < yield.size(); ++j)
+                    efficiency[j] = total > 0 ? yield[j]/total : 0;
+
+                WriteScanHist("h_scan_counts", "events passing unscanned cuts", variations[v].scan);
+                WriteScanHist("h_scan_yield", "events passing thresholds", yield);
+                WriteScanHist("h_scan_eff", "efficiency at thresholds", efficiency);
             }
-            for (auto it = varIndex.begin(); it != varIndex.end(); it++) {
-                print(it->first, 1);
-                print(varValues[it->second], 2);
+        }
+
+    /// QUANTILE SKETCHES
+    ///
+
+        // also keeps a quantile sketch of everything filled into the histogram of ht, so quantiles
+        // and histograms in any binning can be made from the output later. the sketch is written
+        // next to the histogram, named with a q_ prefix instead of h_
+        void AddSketch(Hists::HistType ht) {
+            assert(Sketching() && sketchIndex[ht] < 0);
+            string name = variations[0].hists[histIndex[ht]]->GetName();
+            sketchIndex[ht] = sketchNames.size();
+            sketchNames.push_back("q_" + (name.compare(0, 2, "h_") == 0 ? name.substr(2) : name));
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].sketches.push_back(QuantileSketch(sketchSize));
+        }
+
+        bool Sketching() {
+            return sketchSize > 0;
+        }
+
+        // writes each sketch as a TVectorD, to be read back with QuantileSketch::FromTVector
+        void WriteSketches() {
+            for (size_t v = 0; v < variations.size(); ++v) {
+                OutputDirectory(v)->cd();
+                for (size_t i = 0; i < sketchNames.size(); ++i)
+                    variations[v].sketches[i].ToTVector().Write(sketchNames[i].c_str());
             }
-            if (vectorVarIndex.size() > 0) {
-                log();
-                print("VECTOR VARIABLES:");
+        }
+
+    /// DERIVED VARIABLES
+    ///
+
+        // keeps a column of per-event values, one row per event added to the selection index of
+        // a variation, in the same order as the rows of the input file and entry of each event.
+        // only kept when recording (in-process runs) or writing .npy files
+        void AddColumn(Columns::ColumnType ct, string name) {
+            columnIndex[ct] = columnNames.size();
+            columnNames.push_back(name);
+            for (size_t v = 0; v < variations.size(); ++v)
+                variations[v].columns.push_back(vector<double>());
+        }
+
+        void Record(Columns::ColumnType ct, double value) {
+            Variation & var = variations[active];
+            if (var.writers.empty())
+                var.columns[columnIndex[ct]].push_back(value);
+            else
+                var.writers[columnIndex[ct]]->Append(value);
+        }
+
+        bool Recording() {
+            return recording || npy;
+        }
+
+        // stores the EFlow objects within constituentDR of each of the two leading jets, as the
+        // converter does, by decreasing pt. jet 2i and 2i + 1 belong to row i of the columns
+        void RecordConstituents(const vector<TLorentzVector> & jets, const vector<TLorentzVector> & eflow) {
+            vector<vector<double>> columns(Constituents::Names.size());
+            vector<size_t> sizes;
+            vector<const TLorentzVector*> inside;
+            double dr2 = constituentDR*constituentDR;
+            for (size_t j = 0; j < 2 && j < jets.size(); ++j) {
+                inside.clear();
+                for (size_t i = 0; i < eflow.size(); ++i) {
+                    double deta = eflow[i].Eta() - jets[j].Eta();
+                    double dphi = jets[j].DeltaPhi(eflow[i]);
+                    if (deta*deta + dphi*dphi < dr2)
+                        inside.push_back(&eflow[i]);
+                }
+                std::stable_sort(inside.begin(), inside.end(), [](const TLorentzVector* a, const TLorentzVector* b) { return a->Pt() > b->Pt(); });
+                for (size_t i = 0; i < inside.size(); ++i) {
+                    columns[0].push_back(inside[i]->Eta());
+                    columns[1].push_back(inside[i]->Phi());
+                    columns[2].push_back(inside[i]->Pt());
+                    columns[3].push_back(inside[i]->Rapidity());
+                    columns[4].push_back(inside[i]->E());
+                }
+                sizes.push_back(inside.size());
             }
-            for (auto it = vectorVarIndex.begin(); it != vectorVarIndex.end(); it++) {
-                print(it->first, 1);
-                print(varValues[it->second], 2);
+            AddConstituents(active, columns, sizes);
+        }
+
+        // streams the rows of this core into <outputdir>/<sample>[_<variation>]_<column>.npy from
+        // here on, instead of keeping them. 'tree' and 'entry' (int64) hold the input file (index
+        // in the file list) and entry of each row. constituents go to _constituents_<name>.npy, one row
+        // per constituent, and _constituents_offsets.npy (int64), where jet i holds the constituent rows
+        // [offsets[i], offsets[i + 1]); see selection/constituents.py. call once all columns are
+        // added
+        void OpenColumns() {
+            for (size_t v = 0; v < variations.size(); ++v) {
+                Variation & var = variations[v];
+                var.writers.clear();
+                for (size_t i = 0; i < columnNames.size(); ++i)
+                    var.writers.push_back(std::make_shared<NpyWriter<>>(OutputName(v, "_" + columnNames[i] + ".npy")));
+                var.rowWriters.clear();
+                var.rowWriters.push_back(std::make_shared<NpyWriter<Long64_t>>(OutputName(v, "_tree.npy")));
+                var.rowWriters.push_back(std::make_shared<NpyWriter<Long64_t>>(OutputName(v, "_entry.npy")));
+                var.constituentWriters.clear();
+                var.offsetWriter.reset();
+                if (constituentDR <= 0)
+                    continue;
+                for (size_t i = 0; i < Constituents::Names.size(); ++i)
+                    var.constituentWriters.push_back(std::make_shared<NpyWriter<>>(OutputName(v, "_constituents_" + Constituents::Names[i] + ".npy")));
+                var.offsetWriter = std::make_shared<NpyWriter<Long64_t>>(OutputName(v, "_constituents_offsets.npy"));
+                var.offsetWriter->Append(0);
+                var.constituentTotal = 0;
             }
-            if (MapVectors.size() > 0) {
-                log();
-                print("MAP VECTORS:");
+        }
+
+        // fixes up the headers of the .npy files with their final row counts
+        void WriteColumns() {
+            for (size_t v = 0; v < variations.size(); ++v) {
+                for (size_t i = 0; i < variations[v].writers.size(); ++i)
+                    variations[v].writers[i]->Close();
+                variations[v].writers.clear();
+                for (size_t i = 0; i < variations[v].rowWriters.size(); ++i)
+                    variations[v].rowWriters[i]->Close();
+                variations[v].rowWriters.clear();
+                for (size_t i = 0; i < variations[v].constituentWriters.size(); ++i)
+                    variations[v].constituentWriters[i]->Close();
+                variations[v].constituentWriters.clear();
+                if (variations[v].offsetWriter)
+                    variations[v].offsetWriter->Close();
+                variations[v].offsetWriter.reset();
             }
-            for (auto it = compIndex.begin(); it != compIndex.end(); it++) {
-                if (subIndex[it->second].second == vectorType::Map) {
-                    print(it->first, 1);
-                    print(MapVectors[subIndex[it->second].first], 2);
+        }
+
+    /// MERGING
+    ///
+
+        // moves the cutflow, histogram contents and selection accumulated so far into a partial
+        Partial Export() {
+            Partial p;
+            p.trees.swap(outputTrees);
+            for (size_t v = 0; v < variations.size(); ++v) {
+                Variation & var = variations[v];
+                Partial::Results r;
+                r.cutflow = var.CutFlow;
+                std::fill(var.CutFlow.begin(), var.CutFlow.end(), 0);
+                for (size_t i = 0; i < var.hists.size(); ++i) {
+                    r.hists.push_back(vector<double>(var.hists[i]->GetNbinsX() + 2));
+                    for (int b = 0; b < var.hists[i]->GetNbinsX() + 2; ++b)
+                        r.hists.back()[b] = var.hists[i]->GetBinContent(b);
+                    r.histEntries.push_back(var.hists[i]->GetEntries());
+                    var.hists[i]->Reset();
+                }
+                r.selection.swap(var.selectionIndex);
+                r.scan = var.scan;
+                std::fill(var.scan.begin(), var.scan.end(), 0);
+                for (size_t i = 0; i < var.sketches.size(); ++i) {
+                    r.sketches.push_back(var.sketches[i].ToVector());
+                    var.sketches[i].Reset();
                 }
+                r.columns.swap(var.columns);
+                var.columns.resize(r.columns.size());
+                r.rows.swap(var.rows);
+                r.constituents.swap(var.constituents);
+                var.constituents.resize(r.constituents.size());
+                r.jetSizes.swap(var.jetSizes);
+                p.variations.push_back(r);
             }
-            if (MockVectors.size() > 0) {
-                log();
-                print("MOCK VECTORS:");
+            treeFound.clear();
+            treeOffset = 0;
+            return p;
+        }
+
+        // drops the results accumulated so far, keeping the chain, the collections and the booked
+        // histograms, so the same core can run another selection
+        void ResetResults() {
+            for (size_t v = 0; v < variations.size(); ++v) {
+                Variation & var = variations[v];
+                std::fill(var.CutFlow.begin(), var.CutFlow.end(), 0);
+                for (size_t i = 0; i < var.hists.size(); ++i)
+                    var.hists[i]->Reset();
+                for (size_t i = 0; i < var.selectionIndex.size(); ++i)
+                    var.selectionIndex[i].clear();
+                std::fill(var.scan.begin(), var.scan.end(), 0);
+                for (size_t i = 0; i < var.sketches.size(); ++i)
+                    var.sketches[i].Reset();
+                for (size_t i = 0; i < var.columns.size(); ++i)
+                    var.columns[i].clear();
+                var.rows.clear();
+                for (size_t i = 0; i < var.constituents.size(); ++i)
+                    var.constituents[i].clear();
+                var.jetSizes.clear();
             }
-            for (auto it = compIndex.begin(); it != compIndex.end(); it++) {
-                if (subIndex[it->second].second == vectorType::Mock) {
-                    print(it->first, 1);
-                    print(MockVectors[subIndex[it->second].first], 2);
+            sampled = 0;
+            sampleScale = 1;
+            zoneSkipped = 0;
+        }
+
+        // drops the histograms, variations, scan, sketches, columns and N-1 histograms an analysis
+        // registered, keeping the chain and the layout, so another analysis can be registered on the
+        // same core. its collections are kept, still bound, for the next analysis to take over (see
+        // Registered); those it does not ask for are deleted by the next reset
+        void ResetAnalysis() {
+            DelVector(retired);
+            retired.swap(collections);
+            collections.clear();
+            for (size_t v = 0; v < variations.size(); ++v)
+                DelVector(variations[v].hists);
+            variations.assign(1, Variation("nominal"));
+            variations[0].selectionIndex.resize(outputTrees.size());
+            std::fill(histIndex.begin(), histIndex.end(), 0);
+            std::fill(sketchIndex.begin(), sketchIndex.end(), -1);
+            sketchNames.clear();
+            std::fill(nMinusOneIndex.begin(), nMinusOneIndex.end(), -1);
+            nMinusOneCuts = 0;
+            std::fill(nMinusOneIgnored.begin(), nMinusOneIgnored.end(), 0);
+            std::fill(columnIndex.begin(), columnIndex.end(), 0);
+            columnNames.clear();
+            scanAxes.clear();
+            loadStage = 1;
+            preselection = nullptr;
+            live.reset();
+        }
+
+        // version of the selection; bump it with any change which changes the results of a file,
+        // so results stored by earlier versions (ResultCache, ZoneMap) are no longer used
+        static constexpr const char* SELECTION_VERSION = "1";
+
+        // describes the layout of the partials this core exports; partials can only be merged into
+        // a core with the same layout
+        string Layout() {
+            std::stringstream ss;
+            ss << "hists=" << variations[0].hists.size() << " scan=" << variations[0].scan.size() << " sketches=" << sketchNames.size() << "x" << sketchSize << " columns=" << columnNames.size() << " constituents=" << (constituentDR > 0) << " zones=" << (zoneDir.size() > 0) << " recluster=" << reclusterAlgorithm << ":";
+            for (size_t i = 0; i < reclusterRadii.size(); ++i)
+                ss << reclusterRadii[i] << ",";
+            ss << "pt>" << reclusterPtMin << " variations=";
+            for (size_t v = 0; v < variations.size(); ++v)
+                ss << variations[v].name << (v + 1 < variations.size() ? "," : "");
+            return ss.str();
+        }
+
+        // adds a partial to the results of this core. variations and histograms must have been
+        // registered in the same order as in the core which produced it
+        void Merge(const Partial & p) {
+            MergeSummary(p);
+            MergeRows(p);
+        }
+
+        // adds the cutflow, histograms, scan and sketches of a partial (see Partial::Summary)
+        void MergeSummary(const Partial & p) {
+            assert(p.variations.size() == variations.size());
+            for (size_t v = 0; v < variations.size(); ++v) {
+                Variation & var = variations[v];
+                const Partial::Results & r = p.variations[v];
+                assert(r.hists.size() == var.hists.size());
+                for (size_t i = 0; i < var.CutFlow.size(); ++i)
+                    var.CutFlow[i] += r.cutflow[i];
+                for (size_t i = 0; i < var.hists.size(); ++i) {
+                    for (size_t b = 0; b < r.hists[i].size(); ++b)
+                        var.hists[i]->SetBinContent(b, var.hists[i]->GetBinContent(b) + r.hists[i][b]);
+                    var.hists[i]->SetEntries(var.hists[i]->GetEntries() + r.histEntries[i]);
                 }
+                assert(r.scan.size() == var.scan.size());
+                for (size_t i = 0; i < var.scan.size(); ++i)
+                    var.scan[i] += r.scan[i];
+                assert(r.sketches.size() == var.sketches.size());
+                for (size_t i = 0; i < var.sketches.size(); ++i)
+                    var.sketches[i].Merge(QuantileSketch::FromVector(r.sketches[i]));
             }
-            if (LorentzVectors.size() > 0) {
-                log();
-                print("TLORENTZ VECTORS:");
+        }
+
+        // adds the selected entries, rows and constituents of a partial, and marks its trees found
+        void MergeRows(const Partial & p) {
+            assert(p.variations.size() == variations.size());
+            vector<size_t> slots;
+            for (size_t i = 0; i < p.trees.size(); ++i) {
+                auto it = treeSlot.find(p.trees[i]);
+                if (it == treeSlot.end())
+                    throw "Partial contains unexpected tree '" + p.trees[i] + "'";
+                slots.push_back(it->second);
+                treeFound[it->second] = true;
             }
-            for (auto it = compIndex.begin(); it != compIndex.end(); it++) {
-                if (subIndex[it->second].second == vectorType::Lorentz) {
-                    print(it->first, 1);
-                    print(LorentzVectors[subIndex[it->second].first], 2);
+            for (size_t v = 0; v < variations.size(); ++v) {
+                Variation & var = variations[v];
+                const Partial::Results & r = p.variations[v];
+                for (size_t i = 0; i < slots.size(); ++i) {
+                    vector<size_t> & row = var.selectionIndex[slots[i]];
+                    row.insert(row.end(), r.selection[i].begin(), r.selection[i].end());
+                }
+                assert(r.columns.size() == var.columns.size());
+                for (size_t j = 0; j < r.rows.size(); ++j) {
+                    for (size_t i = 0; i < r.columns.size(); ++i) {
+                        if (var.writers.empty())
+                            var.columns[i].push_back(r.columns[i][j]);
+                        else
+                            var.writers[i]->Append(r.columns[i][j]);
+                    }
+                    AddRow(v, pair<size_t, size_t>(slots[r.rows[j].first], r.rows[j].second));
                 }
+                AddConstituents(v, r.constituents, r.jetSizes);
+            }
+        }
+
+    /// SWITCHES, TIMING, AND LOGGING
+    ///
+
+        // Turn on or off debug logging with this switch
+        void Debug(bool debugSwitch) {
+            debug = debugSwitch;
+        }
+
+        // turn on or off timing logs with this switch (dependent of debug=true)
+        void Timing(bool timingSwitch) {
+            timing=timingSwitch;
+        }
+
+        // prints a summary of the current entry
+        void Current() {
+            log();
+            for (size_t i = 0; i < collections.size(); ++i) {
+                log();
+                print(collections[i]->name + ":");
+                collections[i]->Print(cout, LOG_PREFIX + string(6, ' '));
             }
             log(); 
             log();
@@ -588,7 +1824,68 @@ public:
         // internal debug switch
         bool debug=true, timing=true, saveCuts=true; 
 
-        vector<int> CutFlow = vector<int>(Cuts::COUNT + 1, 0);
+        // multi-sample and threading options; when streaming, inputspec is a growing list file, a
+        // pipe or a directory (see FileStream.h)
+        bool manifest=false, streaming=false;
+        int nThreads=1;
+        // pin pool workers to NUMA nodes and keep per-node results, on machines with several
+        bool numa=true;
+
+        // file of named variations, evaluated alongside the nominal selection
+        string variationSpec;
+
+        // file of scanned cuts and their threshold grids
+        string scanSpec;
+
+        // distributed running: the port a coordinator listens on, the host:port a worker
+        // connects to, and the number of entries per work unit (0 for whole files)
+        int coordinatorPort = -1;
+        string coordinatorAddress;
+        Long64_t chunkSize = 0;
+
+        // directory of cached per-file results
+        string cacheDir;
+
+        // local scratch directory for copies of the inputs, and the space they may take
+        string stageDir;
+        long long stageSize = 20000000000LL;
+
+        // size k of the quantile sketches; 0 keeps none
+        int sketchSize = 0;
+
+        // keep columns of derived variables for selected events, or stream them to .npy files
+        bool recording = false;
+        bool npy = false;
+
+        // relative precision wanted on every cutflow efficiency when sampling (0 runs everything),
+        // and the entries run so far
+        double samplePrecision = 0;
+        Long64_t sampled = 0;
+
+        // cone around the two leading jets of selected events whose EFlow objects are stored as
+        // their constituents (0 stores none)
+        double constituentDR = 0;
+
+        // radii of the EFlow jets reclustered for selected events (none by default), their
+        // algorithm ('antikt', 'kt' or 'ca'), and the pt (GeV) below which jets are dropped
+        vector<double> reclusterRadii;
+        string reclusterAlgorithm = "antikt";
+        double reclusterPtMin = 20.;
+
+        // directory of zone maps of the inputs (none by default), and the entries they let
+        // ProcessRange skip
+        string zoneDir;
+        Long64_t zoneSkipped = 0;
+
+        // file of the live snapshot of the results (none by default), normally under /dev/shm
+        string livePath;
+
+        // entries read by this core, for progress reports from other threads
+        std::atomic<Long64_t> entriesRead{0};
+
+        // staged copies of the inputs, opened by the chain instead of the sources when set
+        StagingCache* staging = nullptr;
+
         int last = 1;
                     
 private:
@@ -609,113 +1906,153 @@ private:
             }            
         }
 
+        // seconds since the epoch
+        static double UnixTime() {
+            return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        // comma separated jet radii, e.g. 0.4,0.8,1.2
+        static vector<double> ParseRadii(const string & spec) {
+            vector<double> radii;
+            std::stringstream ss(spec);
+            string r;
+            while (std::getline(ss, r, ','))
+                if (r.size() > 0)
+                    radii.push_back(std::stod(r));
+            return radii;
+        }
+
     /// VARIABLE TRACKER HELPERS
     /// 
     
-        void AddCompsBase(string& vectorName, vector<string>& components) {
-            if(compIndex.find(vectorName) != compIndex.end())
-                throw "Vector variable '" + vectorName + "' already exists!"; 
-            size_t index = compIndex.size();
-            logp("Adding " + to_string(components.size()) + " components to vector " + vectorName + "...  "); 
-            compVectors.push_back(vector<vector<TLeaf*>>());
-            compNames.push_back(vector<string>());
-            // cout << endl; 
-            for (size_t i = 0; i < components.size(); ++i) {
-                auto inp = chain->FindLeaf(components[i].c_str());
-                // cout << i << " " << inp.size() << endl; 
-                compVectors[index].push_back(inp);
-                compNames[index].push_back(lastWord(components[i]));
-            }
-            // cout << endl; 
-            // cout << compVectors[index][0].size()  << endl; 
-            // cout << compVectors[index].size() << endl;
-            // cout << compVectors.size() << endl; 
-            compIndex[vectorName] = index;
-        }
-
-    /// ENTRY LOADER HELPERS
-    /// 
-
-        void SetLorentz(size_t leafIndex, size_t lvIndex, size_t treeIndex) {
-            vector<vector<TLeaf*>> & v = compVectors[leafIndex];
-            vector<TLorentzVector> * ret = LorentzVectors[lvIndex];
-
-            ret->clear();
-            size_t n = v[0][treeIndex]->GetLen();
-            // cout << endl << n << v[1]->GetLen() << v[2]->GetLen() << v[3]->GetLen() << endl;
-            for (size_t i = 0; i < n; ++i) {
-                ret->push_back(TLorentzVector());
-                ret->at(i).SetPtEtaPhiM(
-                    v[0][treeIndex]->GetValue(i),
-                    v[1][treeIndex]->GetValue(i),
-                    v[2][treeIndex]->GetValue(i),
-                    v[3][treeIndex]->GetValue(i)
-                );
+        void AddCollectionBase(Collections::CollectionBase* c) {
+            for (size_t i = 0; i < collections.size(); ++i) {
+                if (collections[i]->name == c->name) {
+                    delete c;
+                    throw "Vector variable '" + collections[i]->name + "' already exists!"; 
+                }
             }
+            c->stage = loadStage;
+            collections.push_back(c);
+            // registered after the current tree was bound, so the leaves are resolved again
+            boundTree = -1;
         }
 
-        void SetMock(size_t leafIndex, size_t mvIndex, size_t treeIndex) {
-            vector<vector<TLeaf*>> & v = compVectors[leafIndex];
-            vector<TLorentzMock>* ret = MockVectors[mvIndex];   
-            ret->clear();        
+        // takes over a collection of the same name and type kept by ResetAnalysis, with its leaves
+        // still bound, or returns nullptr. collections only depend on the core's settings, so one
+        // kept under the same name reads the same leaves
+        template<typename collection>
+        collection* Registered(const string & name) {
+            for (size_t i = 0; i < retired.size(); ++i) {
+                collection* c = dynamic_cast<collection*>(retired[i]);
+                if (retired[i]->name == name && c != nullptr) {
+                    retired.erase(retired.begin() + i);
+                    c->stage = loadStage;
+                    collections.push_back(c);
+                    return c;
+                }
+            }
+            return nullptr;
+        }
 
-            size_t n = v[0][treeIndex]->GetLen(), size = v.size();
+    /// CUT HELPERS
+    ///
 
-            for(size_t i = 0; i < n; ++i) {
-                switch(size) {
-                    case 2: {
-                        ret->push_back(TLorentzMock(v[0][treeIndex]->GetValue(i), v[1][treeIndex]->GetValue(i)));
-                        break;
-                    }
-                    case 3: {
-                        ret->push_back(TLorentzMock(v[0][treeIndex]->GetValue(i), v[1][treeIndex]->GetValue(i), v[2][treeIndex]->GetValue(i)));
-                        break;
-                    }
-                    case 4: {
-                        ret->push_back(TLorentzMock(v[0][treeIndex]->GetValue(i), v[1][treeIndex]->GetValue(i), v[2][treeIndex]->GetValue(i), v[3][treeIndex]->GetValue(i)));
-                        break;
-                    }
-                    default: {
-                        throw "Invalid number arguments for MockTLorentz vector (" + to_string(size) + ")";
-                    }                   
-                }
+        // fills the N-1 histograms of the current event from its pass bitmask: the histogram of a
+        // cut is filled if every other cut with an N-1 histogram passed, whatever the cut itself
+        // and the cuts on the same variable did
+        void FillNMinusOne() {
+            if (nMinusOneCuts == 0)
+                return;
+            Variation & var = variations[active];
+            unsigned passed = 0;
+            for (size_t i = 0; i < var.cutValues.size(); ++i)
+                if (var.cutValues[i] > 0)
+                    passed |= 1u << i;
+            for (size_t i = 0; i < nMinusOneIndex.size(); ++i) {
+                unsigned others = nMinusOneCuts & ~(1u << i) & ~nMinusOneIgnored[i];
+                if (nMinusOneIndex[i] >= 0 && (passed & others) == others && !std::isnan(var.cutVariables[i]))
+                    var.hists[nMinusOneIndex[i]]->Fill(var.cutVariables[i]);
             }
         }
 
-        void SetMap(size_t leafIndex, size_t mIndex, size_t treeIndex) {
-            vector<vector<TLeaf*>> & v = compVectors[leafIndex];
+    /// DERIVED VARIABLE HELPERS
+    ///
 
-            // cout << mIndex << endl;
-            // cout << leafIndex << endl;
-            // cout << MapVectors.size() << endl; 
-            vector<vector<double>>* ret = MapVectors[mIndex];
-            size_t n = v[0][treeIndex]->GetLen();
+        // the input file and entry of a new row of the columns of variation v
+        void AddRow(size_t v, const pair<size_t, size_t> & row) {
+            Variation & var = variations[v];
+            if (var.rowWriters.empty()) {
+                var.rows.push_back(row);
+                return;
+            }
+            var.rowWriters[0]->Append(row.first);
+            var.rowWriters[1]->Append(row.second);
+        }
 
-            ret->clear(); 
-            ret->resize(n);
-            
-            for (size_t i = 0; i < n; ++i) {
-                ret->at(i).clear();
-                ret->at(i).reserve(v.size());
-                for (size_t j = 0; j < v.size(); ++j) {
-                    ret->at(i).push_back(v[j][treeIndex]->GetValue(i));
-                }
+        // appends the constituents of some jets to variation v, given as one flat array per
+        // Constituents::Names entry and the number of constituents of each jet
+        void AddConstituents(size_t v, const vector<vector<double>> & columns, const vector<size_t> & sizes) {
+            Variation & var = variations[v];
+            if (var.constituentWriters.empty()) {
+                for (size_t i = 0; i < columns.size(); ++i)
+                    var.constituents[i].insert(var.constituents[i].end(), columns[i].begin(), columns[i].end());
+                var.jetSizes.insert(var.jetSizes.end(), sizes.begin(), sizes.end());
+                return;
+            }
+            for (size_t i = 0; i < columns.size(); ++i)
+                for (size_t j = 0; j < columns[i].size(); ++j)
+                    var.constituentWriters[i]->Append(columns[i][j]);
+            for (size_t j = 0; j < sizes.size(); ++j) {
+                var.constituentTotal += sizes[j];
+                var.offsetWriter->Append(var.constituentTotal);
             }
         }
 
-        void SetVar(size_t leafIndex, size_t treeIndex) {
-            *varValues[leafIndex] = varLeaves[leafIndex][treeIndex]->GetValue(0);
+    /// THRESHOLD SCAN HELPERS
+    ///
+
+        // bin of a value along a scanned axis, with the same under/overflow convention as TAxis
+        static size_t ScanBin(const ScanAxis & axis, double value) {
+            if (value < axis.min)
+                return 0;
+            if (value >= axis.max)
+                return axis.bins + 1;
+            return 1 + size_t(axis.bins*(value - axis.min)/(axis.max - axis.min));
         }
 
-        void SetVectorVar(size_t leafIndex, size_t treeIndex) {
-            vectorVarValues[leafIndex]->clear();
-            for (int i = 0; i < vectorVarLeaves[leafIndex][treeIndex]->GetLen(); ++i) {
-                vectorVarValues[leafIndex]->push_back(vectorVarLeaves[leafIndex][treeIndex]->GetValue(i));
+        void WriteScanHist(string name, string title, const vector<double> & contents) {
+            if (scanAxes.size() == 2) {
+                const ScanAxis & x = scanAxes[0], & y = scanAxes[1];
+                TH2D h(name.c_str(), (title + ";" + x.name + ";" + y.name).c_str(), x.bins, x.min, x.max, y.bins, y.min, y.max);
+                h.SetDirectory(0);
+                for (int j = 0; j < y.bins + 2; ++j)
+                    for (int i = 0; i < x.bins + 2; ++i)
+                        h.SetBinContent(i, j, contents[i + j*(x.bins + 2)]);
+                h.Write();
+                return;
+            }
+            int dim = scanAxes.size();
+            vector<Int_t> bins(dim);
+            vector<Double_t> mins(dim), maxs(dim);
+            for (int i = 0; i < dim; ++i) {
+                bins[i] = scanAxes[i].bins;
+                mins[i] = scanAxes[i].min;
+                maxs[i] = scanAxes[i].max;
             }
-            // log(leafIndex);
-            // log(vectorVarLeaves[leafIndex]->GetLen());
-            // log(vectorVarValues[leafIndex].size());
-            // log();
+            THnD h(name.c_str(), title.c_str(), dim, bins.data(), mins.data(), maxs.data());
+            for (int i = 0; i < dim; ++i)
+                h.GetAxis(i)->SetTitle(scanAxes[i].name.c_str());
+            vector<Int_t> coords(dim);
+            for (size_t j = 0; j < contents.size(); ++j) {
+                size_t rest = j;
+                for (int i = 0; i < dim; ++i) {
+                    coords[i] = rest % (bins[i] + 2);
+                    rest /= bins[i] + 2;
+                }
+                h.SetBinContent(coords.data(), contents[j]);
+            }
+            h.Write();
         }
 
     /// SWITCH, TIMING, AND LOGGING HELPERS
@@ -847,9 +2184,22 @@ private:
         int currentEntry;
 
         // histogram data
-        vector<TH1F*> hists;
         vector<size_t> histIndex = vector<size_t>(Hists::COUNT);
 
+        // sketch data: the sketch of each histogram type, or -1, and the sketch names
+        vector<int> sketchIndex = vector<int>(Hists::COUNT, -1);
+
+        // N-1 histogram of each cut, or -1, the cuts which have one as a bitmask, and the cuts left
+        // out of the N-1 condition of each
+        vector<int> nMinusOneIndex = vector<int>(Cuts::COUNT, -1);
+        unsigned nMinusOneCuts = 0;
+        vector<unsigned> nMinusOneIgnored = vector<unsigned>(Cuts::COUNT, 0);
+        vector<string> sketchNames;
+
+        // derived variable data
+        vector<size_t> columnIndex = vector<size_t>(Columns::COUNT);
+        vector<string> columnNames;
+
         // timing data
         double duration = 0;
         std::chrono::high_resolution_clock::time_point timestart, programstart;
@@ -858,38 +2208,83 @@ private:
         ParallelTreeChain *chain=nullptr;
         TFile *file=nullptr; 
         vector<string> outputTrees;
+        vector<bool> treeFound;
+        size_t treeOffset = 0;
+        std::map<string, size_t> treeSlot;
+
+        // set on worker and per-sample cores
+        bool quiet = false;
 
         // logging data
         const string LOG_PREFIX = "SVJselection :: ";
-        std::map<vectorType, std::string> componentTypeStrings = {
-            {vectorType::Lorentz, "TLorentzVector"},
-            {vectorType::Mock, "MockTLorentzVector"},
-            {vectorType::Map, "Map"}
-        };
 
-        // single variable data
-        std::map<string, size_t> varIndex;
-        vector<vector<TLeaf *>> varLeaves; // CHANGE
-        vector<double*> varValues;
-
-        // vector variable data
-        std::map<string, size_t> vectorVarIndex;
-        vector<vector<TLeaf *>> vectorVarLeaves; // CHANGE
-        vector<vector<double>*> vectorVarValues;
-
-        // vector component data
-        //   indicies
-        std::map<string, size_t> compIndex;
-        vector<pair<size_t, vectorType>> subIndex;
-        //   names
-        vector<vector<vector<TLeaf*>>> compVectors; // CHANGE
-        vector<vector<string>> compNames;
-        //   values
-        vector< vector< TLorentzVector >*> LorentzVectors;
-        vector< vector< TLorentzMock >*> MockVectors;
-        vector<vector<vector<double>>*> MapVectors;
+        // registered collections, and the tree their leaves are bound to. the layout outlives the
+        // chains a core opens, so each leaf schema is searched once per core
+        vector<Collections::CollectionBase*> collections;
+        vector<Collections::CollectionBase*> retired;
+        int boundTree = -1;
+        LeafLayout layout;
+
+        // stage of newly registered collections, the preselection deciding on stage 2, and
+        // whether stage 2 was read for the current entry
+        int loadStage = 1;
+        std::function<bool()> preselection;
+        bool fullEntry = true, lateLoaded = false;
+
+        // files kept open by UseFile, most recently used first
+        vector<std::pair<string, ParallelTreeChain*>> openFiles;
+        static const size_t MAX_OPEN_FILES = 8;
+
+        // staging cache of a serial run; pooled runs share one owned by the pool
+        std::unique_ptr<StagingCache> ownedStaging;
+
+        // zone maps of the inputs, opened on first use
+        std::unique_ptr<ZoneMap> zones;
+
+        // live snapshot, made on first publish, the entries seen and the start and last publish
+        // times. the clock is only read every LIVE_CHECK_ENTRIES entries
+        std::unique_ptr<LiveSnapshot> live;
+        Long64_t liveEntries = 0;
+        double liveStart = 0;
+        std::chrono::steady_clock::time_point liveLast;
+        static const Long64_t LIVE_CHECK_ENTRIES = 1024;
+        static constexpr double LIVE_INTERVAL = 1.;
 
         // cut variables
-        vector<int> cutValues = vector<int>(Cuts::COUNT, -1); 
-        vector<vector<size_t>> selectionIndex;
+        struct Variation {
+            Variation(string name) : name(name) {}
+            string name;
+            vector<int> CutFlow = vector<int>(Cuts::COUNT + 1, 0);
+            vector<int> cutValues = vector<int>(Cuts::COUNT, -1);
+            // values of the cut variables of the current event, NAN where none was recorded
+            vector<double> cutVariables = vector<double>(Cuts::COUNT, NAN); 
+            // how each cut is made, for zone maps (see DescribeCut)
+            vector<ZoneMap::Rule> rules = vector<ZoneMap::Rule>(Cuts::COUNT);
+            vector<TH1F*> hists;
+            vector<vector<size_t>> selectionIndex;
+            vector<double> scan;
+            vector<QuantileSketch> sketches;
+            vector<vector<double>> columns;
+            vector<pair<size_t, size_t>> rows;
+            // .npy files of the columns, and of the row trees and entries, once opened
+            vector<std::shared_ptr<NpyWriter<>>> writers;
+            vector<std::shared_ptr<NpyWriter<Long64_t>>> rowWriters;
+            vector<vector<double>> constituents = vector<vector<double>>(Constituents::Names.size());
+            vector<size_t> jetSizes;
+            // .npy files of the constituent columns and of the jet offsets, once opened, and the
+            // constituents written so far
+            vector<std::shared_ptr<NpyWriter<>>> constituentWriters;
+            std::shared_ptr<NpyWriter<Long64_t>> offsetWriter;
+            size_t constituentTotal = 0;
+        };
+        vector<Variation> variations = vector<Variation>(1, Variation("nominal"));
+
+        // sampling: confidence level of the efficiency intervals, entries to run before the first
+        // stopping check, seed of the cluster order, and the scale of a stopped run's histograms
+        static constexpr double SAMPLE_CONFIDENCE = 0.682689;
+        static const Long64_t MIN_SAMPLE_ENTRIES = 1000;
+        static const unsigned SAMPLE_SEED = 12345;
+        double sampleScale = 1;
+        vector<ScanAxis> scanAxes;
+        size_t active = 0;
 };
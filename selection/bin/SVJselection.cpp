@@ -1,83 +1,54 @@
-#include "TLorentzMock.h"
-#include "SVJFinder.h"
-#include <math.h>
-#include "DataFormats/Math/interface/deltaPhi.h"
+#include "SVJAnalysis.h"
+#include "SamplePool.h"
+#include "StreamPool.h"
+#include "Coordinator.h"
+#include "SelectionService.h"
 
-using std::sin;
-using std::cos;
-using std::sqrt; 
-using std::abs; 
-
-namespace Vetos {
-    bool LeptonVeto(TLorentzMock& lepton) {
-        return fabs(lepton.Pt()) > 10 && fabs(lepton.Eta()) < 2.4;
-    }
- 
-    bool IsolationVeto(double &iso) {
-        return iso >= 0.4;
+int main(int argc, char **argv) {
+    // long running service: keep cores warm and run the jobs sent to the socket
+    if (argc == 3 && string(argv[1]) == "--serve") {
+        SelectionService service(argv[2]);
+        service.Run();
+        return 0;
     }
 
-    bool JetEtaVeto(TLorentzVector& jet) {
-        return abs(jet.Eta()) < 2.4;
-    }
+    // declare core object and enable debug
+    SVJFinder core(argc, argv);
 
-    bool JetDeltaEtaVeto(TLorentzVector& jet1, TLorentzVector& jet2) {
-        return abs(jet1.Eta() - jet2.Eta()) < 1.5;
+    // distributed running: serve work units to worker processes, or be one of them
+    if (core.coordinatorAddress.size() > 0) {
+        RemoteWorker<SVJAnalysis> worker(core);
+        worker.Run();
+        return 0;
     }
-
-    bool JetPtVeto(TLorentzVector& jet) {
-        return jet.Pt() > 200.;
+    if (core.coordinatorPort > 0) {
+        Coordinator<SVJAnalysis> coordinator(core);
+        coordinator.Run();
+        return 0;
     }
-}
 
-size_t leptonCount(vector<TLorentzMock>* leptons, vector<double>* isos) {
-    size_t n = 0;
-    // size_t lepton_size = std::min(leptons->size(), isos->size());
-    for (size_t i = 0; i < leptons->size(); ++i)
-        if (Vetos::LeptonVeto(leptons->at(i)) && Vetos::IsolationVeto(isos->at(i))) 
-            n++;
-    return n;
-}
+    // files which are still being produced: run each through a worker pool as it arrives
+    if (core.streaming) {
+        StreamPool<SVJAnalysis> pool(core);
+        pool.Run();
+        return 0;
+    }
 
-int main(int argc, char **argv) {
-    // declare core object and enable debug
-    SVJFinder core(argv);
+    // many samples, many threads, or cached results: run every file through a shared worker pool
+    if (core.manifest || core.nThreads > 1 || core.cacheDir.size() > 0) {
+        SamplePool<SVJAnalysis> pool(core);
+        pool.Run();
+        return 0;
+    }
 
     // make file collection and chain
     // core.MakeFileCollection();
     core.MakeChain();
 
-    // add histogram tracking
-    core.AddHist(Hists::dEta, "h_dEta", "#Delta#eta(j0,j1)", 100, 0, 10);
-    core.AddHist(Hists::dPhi, "h_dPhi", "#Delta#Phi(j0,j1)", 100, 0, 5);
-    core.AddHist(Hists::tRatio,  "h_transverseratio", "MET/M_{T}", 100, 0, 1);
-    core.AddHist(Hists::met2, "h_Mt", "m_{T}", 750, 0, 7500);
-    core.AddHist(Hists::mjj, "h_Mjj", "m_{JJ}", 750, 0, 7500);
-    core.AddHist(Hists::metPt, "h_METPt", "MET_{p_{T}}", 100, 0, 2000);
-    
-    // histograms for pre/post PT wrt PT cut (i.e. after MET, before PT && afer PT)
-    core.AddHist(Hists::pre_1pt, "h_pre_1pt", "pre PT cut leading jet pt", 100, 0, 2500);
-    core.AddHist(Hists::pre_2pt, "h_pre_2pt", "pre PT cut subleading jet pt", 100, 0, 2500);
-    core.AddHist(Hists::post_1pt, "h_post_1pt", "post PT cut leading jet pt", 100, 0, 2500);
-    core.AddHist(Hists::post_2pt, "h_post_2pt", "post PT cut subleading jet pt", 100, 0, 2500);
-
-    // histograms for pre/post lepton count wrt lepton cut
-    core.AddHist(Hists::pre_lep, "h_pre_lep", "lepton count pre-cut", 10, 0, 10);
-    core.AddHist(Hists::post_lep, "h_post_lep", "lepton count post-cut", 10, 0, 10);
-
-    // mt2 pre cut
-    core.AddHist(Hists::pre_MT, "h_pre_MT", "pre-cut m_{T}", 750, 0, 7500);
-    core.AddHist(Hists::pre_mjj, "h_pre_Mjj", "pre-cut m_{JJ}", 750, 0, 7500); 
-    
-    // add componenets for jets (tlorentz)
-
-    vector<TLorentzVector>* Jets = core.AddLorentz("Jet", {"Jet.PT","Jet.Eta","Jet.Phi","Jet.Mass"});
-    vector<TLorentzMock>* Electrons = core.AddLorentzMock("Electron", {"Electron.PT","Electron.Eta"});
-    vector<TLorentzMock>* Muons = core.AddLorentzMock("Muon", {"MuonLoose.PT", "MuonLoose.Eta"});
-    vector<double>* MuonIsolation = core.AddVectorVar("MuonIsolation", "MuonLoose.IsolationVarRhoCorr");
-    vector<double>* ElectronIsolation = core.AddVectorVar("ElectronIsolation", "Electron.IsolationVarRhoCorr"); 
-    double* metFull_Pt = core.AddVar("metMET", "MissingET.MET");
-    double* metFull_Phi = core.AddVar("metPhi", "MissingET.Phi");
+    // add histogram tracking and components for jets/leptons/met
+    SVJAnalysis analysis(core);
+    if (core.npy)
+        core.OpenColumns();
 
     // disable debug
     core.Debug(false);
@@ -88,140 +59,27 @@ int main(int argc, char **argv) {
     core.start();
 
 
-    for (Int_t entry = core.nMin; entry < core.nMax; ++entry) {
-
-        // init
-        core.InitCuts();
-        
-        core.GetEntry(entry);
-
-        // require zero leptons which pass cuts
-        // pre lepton cut
-        core.Fill(Hists::pre_lep, Muons->size() + Electrons->size());
-
-        // made it here
-
-        core.Cut(
-            (leptonCount(Muons, MuonIsolation) + leptonCount(Electrons, ElectronIsolation)) < 1,
-            Cuts::leptonCounts
-            );
-
-        // didn't make it here 
-
-
-
-        if (!core.Cut(Cuts::leptonCounts)) {
-            core.UpdateCutFlow(); 
-            continue;
-        }
-
-
-        core.Fill(Hists::post_lep, Muons->size() + Electrons->size());
-
-
-        // require more than 1 jet
-        core.Cut(
-            Jets->size() > 1,
-            Cuts::jetCounts
-            );
-
-
-
-        // rest of cuts, dependent on jetcount
-        if (core.Cut(Cuts::jetCounts)) {
-
-            TLorentzVector Vjj = Jets->at(0) + Jets->at(1);
-            double metFull_Py = (*metFull_Pt)*sin(*metFull_Phi);
-            double metFull_Px = (*metFull_Pt)*cos(*metFull_Phi);
-            double Mjj = Vjj.M(); // SAVE
-            double Mjj2 = Mjj*Mjj;
-            double ptjj = Vjj.Pt();
-            double ptjj2 = ptjj*ptjj;
-            double ptMet = Vjj.Px()*metFull_Px + Vjj.Py()*metFull_Py;
-            double MT2 = sqrt(Mjj2 + 2*(sqrt(Mjj2 + ptjj2)*(*metFull_Pt) - ptMet)); // SAVE
-
-            // fill pre-cut MT2 histogram
-            core.Fill(Hists::pre_MT, MT2); 
-            core.Fill(Hists::pre_mjj, Mjj); 
-
-            // leading jet etas both meet eta veto
-            core.Cut(
-                Vetos::JetEtaVeto(Jets->at(0)) && Vetos::JetEtaVeto(Jets->at(1)), 
-                Cuts::jetEtas
-                );
-            
-            // leading jets meet delta eta veto
-            core.Cut(
-                Vetos::JetDeltaEtaVeto(Jets->at(0), Jets->at(1)),
-                Cuts::jetDeltaEtas
-                );
-
-            // ratio between calculated mt2 of dijet system and missing momentum is not negligible
-            core.Cut(
-                ((*metFull_Pt) / MT2) > 0.15,
-                Cuts::metRatio
-                );
-
-            // require both leading jets to have transverse momentum greater than 200
-            core.Fill(Hists::pre_1pt, Jets->at(0).Pt()); 
-            core.Fill(Hists::pre_2pt, Jets->at(1).Pt()); 
-
-            core.Cut(
-                Vetos::JetPtVeto(Jets->at(0)) && Vetos::JetPtVeto(Jets->at(1)),
-                Cuts::jetPt
-                );
-            if (!core.Cut(Cuts::jetPt)) {
-                core.UpdateCutFlow(); 
-                continue; 
-            }
-
-            core.Fill(Hists::post_1pt, Jets->at(0).Pt());
-            core.Fill(Hists::post_2pt, Jets->at(1).Pt());
-
-            // conglomerate cut, whether jet is a dijet
-            core.Cut(
-                core.Cut(Cuts::jetEtas) && core.Cut(Cuts::jetPt),
-                Cuts::jetDiJet
-                );
-
-            // magnitude of MT > 1500 
-            core.Cut(
-                MT2 > 1500,
-                Cuts::metValue
-                );
-
-            // tighter MET/MT ratio
-            core.Cut(
-                ((*metFull_Pt) / MT2) > 0.25,
-                Cuts::metRatioTight
-                );
-                 
-            // final selection cut
-            core.Cut(
-                core.CutsRange(0, int(Cuts::selection)) && core.Cut(Cuts::metRatioTight),
-                Cuts::selection
-            ); 
-
-            // save histograms, if passing
-            if (core.Cut(Cuts::selection)) {
-                core.UpdateSelectionIndex(entry); 
-                core.Fill(Hists::dEta, fabs(Jets->at(0).Eta() - Jets->at(1).Eta())); 
-                core.Fill(Hists::dPhi, fabs(reco::deltaPhi(Jets->at(0).Phi(), Jets->at(1).Phi())));
-                core.Fill(Hists::tRatio, (*metFull_Pt) / MT2);
-                core.Fill(Hists::mjj, Vjj.M());
-                core.Fill(Hists::met2, MT2);
-                core.Fill(Hists::metPt, *metFull_Pt);
-                
-            }
-
+    if (core.Sampling()) {
+        // randomly ordered clusters, until every efficiency is known to the requested precision
+        vector<pair<Int_t, Int_t>> ranges = core.SampleRanges();
+        for (size_t r = 0; r < ranges.size() && !core.Precise(); ++r) {
+            core.ProcessRange(analysis, ranges[r].first, ranges[r].second);
+            core.sampled += ranges[r].second - ranges[r].first;
         }
-        core.UpdateCutFlow(); 
+        core.ScaleSample();
+    }
+    else {
+        core.ProcessRange(analysis, core.nMin, core.nMax);
     }
+    core.PublishLive(true);
 
     core.Debug(true);
     core.end();
     core.logt();
     core.WriteHists();
+    core.WriteScan();
+    core.WriteSketches();
+    core.WriteColumns();
     core.WriteSelectionIndex(); 
     core.SaveCutFlow();
     core.PrintCutFlow();
@@ -0,0 +1,438 @@
+#pragma once
+#include "SVJFinder.h"
+#include "ResultCache.h"
+#include "NumaTopology.h"
+#include "TROOT.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <sys/stat.h>
+
+// runs the selection over the files of one or more samples with a single pool of worker threads.
+// each worker starts out with a share of the files, largest files first. the worker which takes a
+// file opens it and breaks it into ranges of whole TTree clusters, keeps the first and queues the
+// rest in front of its own queue. workers steal from the back of the other queues once their own
+// runs dry, so even a single huge file keeps every thread busy. workers keep
+// their own handles and leaf bindings for the files they touch. each sample still gets its own
+// outputs. on machines with several NUMA nodes, workers are pinned to nodes in blocks, steal from
+// workers of their own node before going across, and merge the cutflow, histograms, scan and
+// sketches into per-node replicas, which are only reduced once all workers are done. the selected
+// entries, rows and constituents grow with the events passing, so they go straight to the sample
+// as each range finishes rather than piling up in the replicas; the buffers and histograms a
+// worker allocates are first touched by it, so they live on its node
+template<typename analysis>
+class SamplePool {
+public:
+    SamplePool(SVJFinder & config) : config(config) {}
+
+    ~SamplePool() {
+        for (size_t i = 0; i < samples.size(); ++i) {
+            delete samples[i].selection;
+            delete samples[i].core;
+        }
+    }
+
+    void Run() {
+        TH1::AddDirectory(kFALSE);
+        RejectSerialOptions();
+        config.start();
+        ReadSamples();
+        MakeTasks();
+        UseCache();
+        Stage();
+        Distribute();
+        config.end();
+        config.logt();
+
+        if (Replicated())
+            config.log("Placing " + to_string(config.nThreads) + " threads on " + to_string(numa.Nodes()) + " NUMA nodes, with per-node results");
+
+        config.log("Processing " + to_string(tasks.size()) + " files from " + to_string(samples.size()) + " samples on " + to_string(config.nThreads) + " threads");
+        config.log();
+
+        ROOT::EnableThreadSafety();
+        config.start();
+        vector<std::thread> workers;
+        for (int i = 0; i < config.nThreads; ++i)
+            workers.push_back(std::thread(&SamplePool::Work, this, i));
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+        config.end();
+        config.logt();
+
+        if (!error.empty())
+            throw error;
+
+        Reduce();
+        WriteOutputs();
+    }
+
+protected:
+    // entry ranges count entries of one chain, and sampling stops one chain early, while pools
+    // run whole files (or their clusters) of many; rather than silently run something else than
+    // was asked for, refuse them. live snapshots are published from the entry loop of one core,
+    // which the pools' sample cores never run
+    void RejectSerialOptions() {
+        if (config.nMin > 0 || config.nMax >= 0)
+            throw string("Entry ranges are only available in serial runs, not with threads, manifests, caches or workers");
+        if (config.Sampling())
+            throw string("Sampling is only available in serial runs, not with threads, manifests, caches or workers");
+        if (config.livePath.size() > 0)
+            throw string("Live snapshots are only available in serial runs, not with threads, manifests, caches or workers");
+    }
+
+    struct Sample {
+        SVJFinder* core;
+        analysis* selection;
+    };
+
+    // a file, or the entries [first, last) of it; last < 0 means up to the end of the file
+    struct Task {
+        size_t sample;
+        string filename;
+        long long size;
+        Long64_t first = 0;
+        Long64_t last = -1;
+        // index of the whole-file task this range was split from
+        size_t file = 0;
+    };
+
+    void WriteOutputs() {
+        for (size_t i = 0; i < samples.size(); ++i) {
+            SVJFinder & core = *samples[i].core;
+            config.log();
+            config.log("Writing outputs for sample " + core.sample);
+            core.MakeOutput();
+            core.WriteHists();
+            core.WriteScan();
+            core.WriteSketches();
+            core.WriteColumns();
+            core.WriteSelectionIndex();
+            core.SaveCutFlow();
+            if (config.debug)
+                core.PrintCutFlow();
+        }
+    }
+
+    // manifest lines are '<sample name> <file list>'; without a manifest, the input spec is
+    // the file list of the single sample named on the command line
+    void ReadSamples() {
+        vector<pair<string, string>> specs;
+        if (config.manifest) {
+            vector<string> lines = ReadLines(config.inputspec);
+            for (size_t i = 0; i < lines.size(); ++i) {
+                stringstream ss(lines[i]);
+                string name, filelist;
+                if (!(ss >> name >> filelist))
+                    throw "Malformed manifest line '" + lines[i] + "'";
+                specs.push_back(std::make_pair(name, filelist));
+            }
+        }
+        else {
+            specs.push_back(std::make_pair(config.sample, config.inputspec));
+        }
+
+        for (size_t i = 0; i < specs.size(); ++i) {
+            Sample s;
+            s.core = new SVJFinder(SVJFinder::InheritSettings(), config, specs[i].first);
+            s.selection = new analysis(*s.core);
+            if (config.npy)
+                s.core->OpenColumns();
+            vector<string> filenames = ReadLines(specs[i].second);
+            s.core->ExpectTrees(filenames);
+            for (size_t j = 0; j < filenames.size(); ++j) {
+                Task t;
+                t.sample = samples.size();
+                t.filename = filenames[j];
+                t.size = FileSize(filenames[j]);
+                tasks.push_back(t);
+            }
+            samples.push_back(s);
+            config.log("Sample " + specs[i].first + ": " + to_string(filenames.size()) + " files");
+        }
+    }
+
+    // merges the cached results of unchanged files, and drops those files from the tasks. results
+    // of the remaining files are added to the cache as they finish
+    void UseCache() {
+        if (config.cacheDir.empty() || samples.empty())
+            return;
+        cache.reset(new ResultCache(config.cacheDir, *samples[0].core));
+        vector<Task> remaining;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            SVJFinder::Partial p;
+            if (tasks[i].first == 0 && tasks[i].last < 0 && cache->Load(tasks[i].filename, p))
+                samples[tasks[i].sample].core->Merge(p);
+            else
+                remaining.push_back(tasks[i]);
+        }
+        config.log("Using cached results for " + to_string(tasks.size() - remaining.size()) + " of " + to_string(tasks.size()) + " files");
+        tasks.swap(remaining);
+    }
+
+    // copies the inputs to local scratch space in the background, in the order they are handed out
+    void Stage() {
+        if (config.stageDir.empty())
+            return;
+        staging.reset(new StagingCache(config.stageDir, config.stageSize));
+        vector<string> filenames;
+        for (size_t i = 0; i < tasks.size(); ++i)
+            filenames.push_back(tasks[i].filename);
+        staging->Prefetch(filenames);
+    }
+
+    // longest first; the size on disk stands in for the processing time of a file
+    void MakeTasks() {
+        std::stable_sort(tasks.begin(), tasks.end(), [](const Task & a, const Task & b) { return a.size > b.size; });
+    }
+
+    SVJFinder & config;
+    vector<Sample> samples;
+    vector<Task> tasks;
+    std::unique_ptr<ResultCache> cache;
+    std::unique_ptr<StagingCache> staging;
+
+    // breaks the file a worker has just opened into ranges of whole clusters, in entry order.
+    // clusters are joined up to MIN_RANGE_ENTRIES, so badly clustered trees do not turn into
+    // per-entry ranges. a file without a tree stays one (empty) range
+    vector<Task> SplitClusters(SVJFinder & core, const Task & file) {
+        vector<Task> ranges;
+        Task t = file;
+        if (core.chain->size() > 0) {
+            TTree* tree = core.chain->GetTree(0);
+            Long64_t n = tree->GetEntries();
+            TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+            while (clusters() < n) {
+                Long64_t end = clusters.GetNextEntry();
+                if (end - t.first < MIN_RANGE_ENTRIES && end < n)
+                    continue;
+                t.last = end < n ? end : n;
+                ranges.push_back(t);
+                t.first = t.last;
+            }
+        }
+        if (ranges.empty())
+            ranges.push_back(file);
+        return ranges;
+    }
+
+    // deals whole files, largest first, to the least loaded worker queue, so a worker reads its
+    // files sequentially until it has to steal. each worker steals from the next workers of its
+    // own node first, then from the other nodes
+    void Distribute() {
+        stealOrder.assign(config.nThreads, vector<size_t>());
+        for (int me = 0; me < config.nThreads; ++me) {
+            for (int k = 0; k < config.nThreads; ++k)
+                if (NodeOf((me + k) % config.nThreads) == NodeOf(me))
+                    stealOrder[me].push_back((me + k) % config.nThreads);
+            for (int k = 0; k < config.nThreads; ++k)
+                if (NodeOf((me + k) % config.nThreads) != NodeOf(me))
+                    stealOrder[me].push_back((me + k) % config.nThreads);
+        }
+        nodeResults.assign(numa.Nodes(), vector<SVJFinder::Partial>(samples.size()));
+        nodeLocks.clear();
+        for (size_t n = 0; n < numa.Nodes(); ++n)
+            nodeLocks.push_back(std::unique_ptr<std::mutex>(new std::mutex()));
+
+        rangesLeft.assign(tasks.size(), 1);
+        fileResults.assign(tasks.size(), SVJFinder::Partial());
+        split = 0;
+        queues.assign(config.nThreads, std::deque<Task>());
+        queueLocks.clear();
+        vector<long long> load(config.nThreads, 0);
+        for (int i = 0; i < config.nThreads; ++i)
+            queueLocks.push_back(std::unique_ptr<std::mutex>(new std::mutex()));
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            tasks[t].file = t;
+            size_t target = std::min_element(load.begin(), load.end()) - load.begin();
+            queues[target].push_back(tasks[t]);
+            load[target] += std::max(tasks[t].size, 1LL);
+        }
+    }
+
+    // the next file or range for worker me: the front of its own queue, else the back of another
+    // one. with every queue empty, waits as long as some files have not been split, since their
+    // ranges may still be queued
+    bool Next(size_t me, Task & t) {
+        while (!failed) {
+            size_t seen;
+            {
+                std::lock_guard<std::mutex> lock(splitLock);
+                seen = split;
+            }
+            for (size_t k = 0; k < stealOrder[me].size(); ++k) {
+                size_t q = stealOrder[me][k];
+                std::lock_guard<std::mutex> lock(*queueLocks[q]);
+                if (queues[q].empty())
+                    continue;
+                if (k == 0) {
+                    t = queues[q].front();
+                    queues[q].pop_front();
+                }
+                else {
+                    t = queues[q].back();
+                    queues[q].pop_back();
+                }
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(splitLock);
+            if (split == tasks.size())
+                return false;
+            splitChanged.wait(lock, [this, seen]{ return split != seen || failed; });
+        }
+        return false;
+    }
+
+    // counts a file as split, once its ranges are queued
+    void Split() {
+        {
+            std::lock_guard<std::mutex> lock(splitLock);
+            split++;
+        }
+        splitChanged.notify_all();
+    }
+
+    void Work(size_t me) {
+        if (Replicated())
+            numa.Pin(NodeOf(me));
+        SVJFinder core(SVJFinder::InheritSettings(), config);
+        core.staging = staging.get();
+        analysis selection(core);
+        Task task;
+        while (Next(me, task)) {
+            bool whole = task.first == 0 && task.last < 0;
+            try {
+                core.UseFile(task.filename);
+                if (whole) {
+                    // the rest of the file goes in front of this worker's queue, in entry order
+                    vector<Task> ranges = SplitClusters(core, task);
+                    {
+                        std::lock_guard<std::mutex> lock(mergeLock);
+                        rangesLeft[task.file] += ranges.size() - 1;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(*queueLocks[me]);
+                        for (size_t i = ranges.size(); i-- > 1;)
+                            queues[me].push_front(ranges[i]);
+                    }
+                    task = ranges[0];
+                    whole = false;
+                    Split();
+                }
+                Int_t end = (task.last < 0 || task.last > core.GetEntries()) ? core.GetEntries() : (Int_t)task.last;
+                core.ProcessRange(selection, task.first, end);
+                Finish(task, core.Export(), NodeOf(me));
+            }
+            catch (string & e) {
+                {
+                    std::lock_guard<std::mutex> lock(mergeLock);
+                    error = task.filename + ": " + e;
+                    failed = true;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(splitLock);
+                    if (whole)
+                        split++;
+                }
+                splitChanged.notify_all();
+            }
+        }
+    }
+
+    // merges the results of one range; with several nodes, the summary goes into the replica of
+    // the worker's node and the rows into the sample. once all ranges of a file are in, its
+    // results are cached
+    void Finish(const Task & task, const SVJFinder::Partial & p, size_t node) {
+        if (Replicated()) {
+            SVJFinder::Partial summary = p.Summary();
+            std::lock_guard<std::mutex> lock(*nodeLocks[node]);
+            nodeResults[node][task.sample].Add(summary);
+        }
+        SVJFinder::Partial whole;
+        {
+            std::lock_guard<std::mutex> lock(mergeLock);
+            if (Replicated())
+                samples[task.sample].core->MergeRows(p);
+            else
+                samples[task.sample].core->Merge(p);
+            if (cache)
+                fileResults[task.file].Add(p);
+            if (--rangesLeft[task.file] > 0)
+                return;
+            whole = std::move(fileResults[task.file]);
+            fileResults[task.file] = SVJFinder::Partial();
+            config.log("Finished file " + to_string(++done) + " of " + to_string(rangesLeft.size()) + " (" + samples[task.sample].core->sample + ")");
+        }
+        if (cache)
+            cache->Store(task.filename, whole);
+    }
+
+    // adds the per-node replicas into the sample cores
+    void Reduce() {
+        for (size_t n = 0; Replicated() && n < nodeResults.size(); ++n) {
+            for (size_t i = 0; i < samples.size(); ++i)
+                if (!nodeResults[n][i].variations.empty())
+                    samples[i].core->MergeSummary(nodeResults[n][i]);
+            nodeResults[n].clear();
+        }
+    }
+
+    // workers are pinned and results replicated only with several nodes and threads to place
+    bool Replicated() {
+        return config.numa && config.nThreads > 1 && numa.Nodes() > 1;
+    }
+
+    // workers fill the nodes in contiguous blocks
+    size_t NodeOf(size_t worker) {
+        return Replicated() ? worker*numa.Nodes()/config.nThreads : 0;
+    }
+
+    static vector<string> ReadLines(string filename) {
+        std::ifstream file(filename.c_str());
+        if (!file.is_open())
+            throw "Could not open '" + filename + "'";
+        vector<string> lines;
+        string s;
+        while (getline(file, s))
+            if (s.size() > 0)
+                lines.push_back(s);
+        return lines;
+    }
+
+    static long long FileSize(string filename) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0)
+            return 0;
+        return st.st_size;
+    }
+
+private:
+    static const Long64_t MIN_RANGE_ENTRIES = 100;
+
+    // per-worker queues of files and ranges, and the order each worker takes from them
+    vector<std::deque<Task>> queues;
+    vector<std::unique_ptr<std::mutex>> queueLocks;
+    vector<vector<size_t>> stealOrder;
+
+    // NUMA placement, and per-node results of every sample
+    NumaTopology numa;
+    vector<vector<SVJFinder::Partial>> nodeResults;
+    vector<std::unique_ptr<std::mutex>> nodeLocks;
+
+    // per-file bookkeeping, indexed by Task::file
+    vector<size_t> rangesLeft;
+    vector<SVJFinder::Partial> fileResults;
+
+    // files split into ranges so far
+    size_t split = 0;
+    std::mutex splitLock;
+    std::condition_variable splitChanged;
+
+    std::atomic<bool> failed{false};
+    size_t done = 0;
+    std::mutex mergeLock;
+    string error;
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include "TFile.h"
+#include "TTree.h"
+#include "TEntryList.h"
+#include "TList.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+using std::string;
+using std::vector;
+
+// reads the selected entries of a set of delphes files, as written by
+// SVJFinder::WriteSelectionIndex. entries are visited in file order and, within a file, in
+// cluster order. only the given branches are read, through a TTreeCache trained on them up front,
+// and clusters without selected entries are never touched, so reading a sparse selection costs
+// about as much as the selected clusters. inputs which cannot be read are skipped with a warning
+// and listed by Failed; callers which need every entry check it. usable from PyROOT through
+// gInterpreter.Declare
+class SelectionReader {
+public:
+    // branches are names or patterns for TTree::SetBranchStatus, e.g. "Jet*"
+    SelectionReader(const vector<string> & branches, Long64_t cacheSize=50000000) : branches(branches), cacheSize(cacheSize) {}
+
+    ~SelectionReader() {
+        Close();
+    }
+
+    void AddFile(const string & filename, const vector<Long64_t> & entries) {
+        inputs.push_back(Input{filename, entries});
+        std::sort(inputs.back().entries.begin(), inputs.back().entries.end());
+    }
+
+    // '<file>: <entry> <entry> ...' lines, as in <sample>_selection.txt
+    void AddSelectionText(const string & path) {
+        std::ifstream f(path.c_str());
+        if (!f.is_open())
+            throw "Could not open selection '" + path + "'";
+        string line;
+        while (getline(f, line)) {
+            size_t colon = line.rfind(": ");
+            if (colon == string::npos)
+                continue;
+            std::stringstream ss(line.substr(colon + 2));
+            vector<Long64_t> entries;
+            Long64_t e;
+            while (ss >> e)
+                entries.push_back(e);
+            AddFile(line.substr(0, colon), entries);
+        }
+    }
+
+    // the sub-lists of a TEntryList written by SVJFinder::WriteEntryList
+    void AddEntryList(const string & path, const string & name="selection") {
+        TFile f(path.c_str());
+        TEntryList* list = nullptr;
+        f.GetObject(name.c_str(), list);
+        if (list == nullptr)
+            throw "No entry list '" + name + "' in '" + path + "'";
+        TList* sublists = list->GetLists();
+        if (sublists == nullptr) {
+            AddList(list);
+            return;
+        }
+        for (int i = 0; i < sublists->GetEntries(); ++i)
+            AddList((TEntryList*)sublists->At(i));
+    }
+
+    // moves to the next selected entry and reads it; false once all inputs are done
+    bool Next() {
+        while (true) {
+            if (tree != nullptr && position < Current().entries.size()) {
+                Long64_t entry = Current().entries[position++];
+                if (entry >= clusterEnd)
+                    EnterCluster(entry);
+                tree->GetEntry(entry);
+                current = entry;
+                return true;
+            }
+            if (!OpenNext())
+                return false;
+        }
+    }
+
+    TTree* Tree() {
+        return tree;
+    }
+
+    Long64_t Entry() {
+        return current;
+    }
+
+    const string & File() {
+        return Current().filename;
+    }
+
+    // clusters holding selected entries, and clusters of the opened files without any, so far.
+    // the clusters after the last selected entry of a file are counted once the file is done
+    Long64_t ClustersRead() {
+        return clustersRead;
+    }
+
+    Long64_t ClustersSkipped() {
+        return clustersSkipped;
+    }
+
+    // bytes actually read from the input files so far, as counted by ROOT
+    Long64_t BytesRead() {
+        return bytesRead + (file != nullptr ? file->GetBytesRead() : 0);
+    }
+
+    // inputs with selected entries which could not be opened, or have no delphes tree
+    const vector<string> & Failed() {
+        return failed;
+    }
+
+private:
+    struct Input {
+        string filename;
+        vector<Long64_t> entries;
+    };
+
+    void AddList(TEntryList* list) {
+        vector<Long64_t> entries(list->GetN());
+        for (Long64_t i = 0; i < list->GetN(); ++i)
+            entries[i] = list->GetEntry(i);
+        AddFile(list->GetFileName(), entries);
+    }
+
+    const Input & Current() {
+        return inputs[input];
+    }
+
+    // opens the next input with selected entries, and trains its cache on the branches we read
+    bool OpenNext() {
+        Close();
+        while (++input < (long)inputs.size()) {
+            if (Current().entries.empty())
+                continue;
+            file = TFile::Open(Current().filename.c_str());
+            if (file == nullptr || file->IsZombie()) {
+                std::cerr << "SelectionReader :: WARNING :: could not open " << Current().filename << std::endl;
+                failed.push_back(Current().filename);
+                Close();
+                continue;
+            }
+            file->GetObject("Delphes", tree);
+            if (tree == nullptr) {
+                std::cerr << "SelectionReader :: WARNING :: no Delphes tree in " << Current().filename << std::endl;
+                failed.push_back(Current().filename);
+                Close();
+                continue;
+            }
+            tree->SetBranchStatus("*", 0);
+            tree->SetCacheSize(cacheSize);
+            for (size_t i = 0; i < branches.size(); ++i) {
+                tree->SetBranchStatus(branches[i].c_str(), 1);
+                tree->AddBranchToCache(branches[i].c_str(), kTRUE);
+            }
+            tree->StopCacheLearningPhase();
+            tree->SetCacheEntryRange(Current().entries.front(), Current().entries.back() + 1);
+            clusters.reset(new TTree::TClusterIterator(tree->GetClusterIterator(0)));
+            clusterEnd = 0;
+            position = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // advances the cluster iterator to the cluster holding entry, counting the skipped ones
+    void EnterCluster(Long64_t entry) {
+        while (clusterEnd <= entry) {
+            (*clusters)();
+            clusterEnd = clusters->GetNextEntry();
+            if (clusterEnd <= entry)
+                clustersSkipped++;
+        }
+        clustersRead++;
+    }
+
+    void Close() {
+        if (tree != nullptr && clusters) {
+            Long64_t n = tree->GetEntries();
+            while ((*clusters)() < n)
+                clustersSkipped++;
+        }
+        clusters.reset();
+        if (file != nullptr) {
+            bytesRead += file->GetBytesRead();
+            file->Close();
+            delete file;
+        }
+        file = nullptr;
+        tree = nullptr;
+    }
+
+    vector<string> branches;
+    Long64_t cacheSize;
+    vector<Input> inputs;
+    long input = -1;
+
+    TFile* file = nullptr;
+    TTree* tree = nullptr;
+    std::unique_ptr<TTree::TClusterIterator> clusters;
+    Long64_t clusterEnd = 0;
+    size_t position = 0;
+    Long64_t current = -1;
+    Long64_t clustersRead = 0;
+    Long64_t clustersSkipped = 0;
+    Long64_t bytesRead = 0;
+    vector<string> failed;
+};
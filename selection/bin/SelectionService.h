@@ -0,0 +1,306 @@
+#pragma once
+#include "SVJAnalysis.h"
+#include "Socket.h"
+#include <list>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+// a long running selection process for interactive work, started with
+// 'SVJselection --serve <socket path>'. jobs arrive over a unix socket with the arguments of an
+// SVJselection run, and each is run as the serial binary would, writing the same outputs. the
+// core of a job stays alive afterwards, with its files open, leaves bound and tree caches warm:
+// a later job with the same file list and the same settings only resets the results and runs
+// again, so it skips process start, dictionary loading, opening files and cold caches. the entry
+// range, output directory, logging switches and --sample may change between jobs. a change of
+// the variations or scan (or of their files) keeps the core, and only registers the analysis
+// again; any other change (or an edited file list) gets a new core. the least recently used cores
+// are closed beyond MAX_SESSIONS. jobs run one at a time, in arrival order; a client which sends
+// nothing for CLIENT_TIMEOUT seconds is dropped, and has to connect again.
+//
+// messages (see Socket):
+//   client -> service:  JOB <arguments of SVJselection, one per line>, STOP
+//   service -> client:  RESULT <summary, see Summary>, ERROR <message>
+class SelectionService {
+public:
+    SelectionService(string path) : path(path) {}
+
+    void Run() {
+        TH1::AddDirectory(kFALSE);
+        Socket listener = Socket::ListenLocal(path);
+        Log("Serving selection jobs on " + path);
+        bool stopping = false;
+        while (!stopping) {
+            Socket client = listener.Accept();
+            client.Timeout(CLIENT_TIMEOUT);
+            string type, payload;
+            try {
+                while (!stopping && client.Receive(type, payload)) {
+                    if (type == "STOP") {
+                        stopping = true;
+                        client.Send("RESULT", "stopping\n");
+                    }
+                    else if (type == "JOB") {
+                        string reply;
+                        bool ok = RunJob(Split(payload), reply);
+                        client.Send(ok ? "RESULT" : "ERROR", reply);
+                    }
+                    else {
+                        client.Send("ERROR", "Unknown message '" + type + "'");
+                    }
+                }
+            }
+            catch (string & e) {
+                // a client which went away, or sent garbage; the service carries on
+                Log("WARNING :: " + e);
+            }
+            catch (std::exception & e) {
+                Log("WARNING :: " + string(e.what()));
+            }
+        }
+        sessions.clear();
+        unlink(path.c_str());
+        Log("Stopped");
+    }
+
+private:
+    // a core and its analysis, over one file list with one set of settings, and the variations and
+    // scan the analysis was registered with
+    struct Session {
+        string key, analysisKey;
+        std::unique_ptr<SVJFinder> core;
+        std::unique_ptr<SVJAnalysis> selection;
+        int jobs = 0;
+    };
+
+    static const size_t MAX_SESSIONS = 4;
+    static const int CLIENT_TIMEOUT = 600;
+
+    // runs one job; the reply is its summary, or what went wrong. a failed job takes its core
+    // with it, so the next job with the same settings starts from scratch
+    bool RunJob(const vector<string> & args, string & reply) {
+        string key;
+        try {
+            if (args.size() < 9)
+                throw string("A job needs the positional arguments of SVJselection");
+            key = Key(args);
+            reply = Summary(Run(args, key));
+            return true;
+        }
+        catch (string & e) {
+            reply = e;
+        }
+        catch (const char* e) {
+            reply = e;
+        }
+        catch (std::exception & e) {
+            reply = e.what();
+        }
+        Log("ERROR :: " + reply);
+        sessions.remove_if([&key](const Session & s) { return s.key == key; });
+        return false;
+    }
+
+    SVJFinder & Run(const vector<string> & args, const string & key) {
+        Session & s = Find(args, key);
+        SVJFinder & core = *s.core;
+
+        // settings which may differ from job to job
+        if (s.jobs > 0) {
+            string analysisKey = AnalysisKey(args);
+            if (analysisKey != s.analysisKey) {
+                Log("Registering the analysis of " + core.sample + " again, for new variations or scan");
+                s.selection.reset();
+                core.ResetAnalysis();
+                core.variationSpec = Option(args, "--variations");
+                core.scanSpec = Option(args, "--scan");
+                s.selection.reset(new SVJAnalysis(core));
+                s.analysisKey = analysisKey;
+            }
+            core.outputdir = args[3];
+            core.MakeOutput();
+            core.ResetResults();
+        }
+        core.Debug(std::atoi(args[4].c_str()));
+        core.Timing(std::atoi(args[5].c_str()));
+        core.nMin = std::max(std::stoi(args[7]), 0);
+        core.nMax = std::stoi(args[8]);
+        if (core.nMax < 0 || core.nMax > core.nEvents)
+            core.nMax = core.nEvents;
+        core.samplePrecision = 0;
+        for (size_t i = 9; i + 1 < args.size(); ++i)
+            if (args[i] == "--sample")
+                core.samplePrecision = std::stod(args[i + 1]);
+        if (core.npy)
+            core.OpenColumns();
+
+        Log("Job " + to_string(s.jobs + 1) + " of " + core.sample + ": entries [" + to_string(core.nMin) + ", " + to_string(core.nMax) + ")");
+        bool debug = core.debug;
+        core.Debug(false);
+        core.start();
+        if (core.Sampling()) {
+            vector<pair<Int_t, Int_t>> ranges = core.SampleRanges();
+            for (size_t r = 0; r < ranges.size() && !core.Precise(); ++r) {
+                core.ProcessRange(*s.selection, ranges[r].first, ranges[r].second);
+                core.sampled += ranges[r].second - ranges[r].first;
+            }
+            core.ScaleSample();
+        }
+        else {
+            core.ProcessRange(*s.selection, core.nMin, core.nMax);
+        }
+        core.PublishLive(true);
+        core.Debug(debug);
+        core.end();
+        core.logt();
+        core.WriteHists();
+        core.WriteScan();
+        core.WriteSketches();
+        core.WriteColumns();
+        core.WriteSelectionIndex();
+        core.SaveCutFlow();
+        core.PrintCutFlow();
+        core.CloseOutput();
+        s.jobs++;
+        return core;
+    }
+
+    // the session of a job, made (opening the files and registering the analysis) if new, and
+    // moved to the front as the most recently used
+    Session & Find(const vector<string> & args, const string & key) {
+        for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+            if (it->key == key) {
+                sessions.splice(sessions.begin(), sessions, it);
+                return sessions.front();
+            }
+        }
+
+        vector<char*> argv;
+        string name = "SVJselection";
+        argv.push_back(&name[0]);
+        vector<string> copy = args;
+        for (size_t i = 0; i < copy.size(); ++i)
+            argv.push_back(&copy[i][0]);
+        std::unique_ptr<SVJFinder> core(new SVJFinder(argv.size(), argv.data()));
+        if (core->manifest || core->streaming || core->nThreads > 1 || core->cacheDir.size() > 0 || core->coordinatorPort > 0 || core->coordinatorAddress.size() > 0)
+            throw string("Manifests, streaming, threads, caches and distributed running are not available in served jobs");
+
+        Session s;
+        s.key = key;
+        s.analysisKey = AnalysisKey(args);
+        core->MakeChain();
+        s.selection.reset(new SVJAnalysis(*core));
+        s.core = std::move(core);
+        sessions.push_front(std::move(s));
+        while (sessions.size() > MAX_SESSIONS)
+            sessions.pop_back();
+        return sessions.front();
+    }
+
+    // what a job's core depends on: the listed files, and every argument but the per-job ones
+    // (output directory, debug and timing switches, entry range and --sample) and those of the
+    // analysis (see AnalysisKey)
+    static string Key(const vector<string> & args) {
+        std::stringstream key;
+        key << ReadFile(args[0], "file list") << '\n' << args[0] << '\n' << args[1] << '\n' << args[6] << '\n';
+        for (size_t i = 9; i < args.size(); ++i) {
+            if (args[i] == "--sample" || args[i] == "--variations" || args[i] == "--scan") {
+                ++i;
+                continue;
+            }
+            key << args[i] << '\n';
+        }
+        return key.str();
+    }
+
+    // what a job's analysis depends on beyond its core: the variation and scan files, and their
+    // contents
+    static string AnalysisKey(const vector<string> & args) {
+        std::stringstream key;
+        string variations = Option(args, "--variations"), scan = Option(args, "--scan");
+        key << variations << '\n';
+        if (variations.size() > 0)
+            key << ReadFile(variations, "variation file") << '\n';
+        key << scan << '\n';
+        if (scan.size() > 0)
+            key << ReadFile(scan, "scan file") << '\n';
+        return key.str();
+    }
+
+    // the value of an option of a job, or an empty string
+    static string Option(const vector<string> & args, const string & option) {
+        string value;
+        for (size_t i = 9; i + 1 < args.size(); ++i)
+            if (args[i] == option)
+                value = args[++i];
+        return value;
+    }
+
+    static string ReadFile(const string & filename, const string & what) {
+        std::ifstream in(filename.c_str());
+        if (!in.is_open())
+            throw "Could not open " + what + " '" + filename + "'";
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    // one 'variation <name>' line per variation, followed by its cutflow (entries passing no cut,
+    // then each cut in Cuts::CutType order) and the number of selected entries, then
+    //   hist <name> <bins> <min> <max> <entries> <contents of bins 0 to bins + 1>
+    // for each histogram and
+    //   selection <tree> <entries selected in it>
+    // for each input file with a selected entry. after the variations, 'tree <index> <file>' for
+    // every input file, the entries run and the output file
+    static string Summary(SVJFinder & core) {
+        std::stringstream out;
+        out << std::setprecision(17);
+        for (size_t v = 0; v < core.variations.size(); ++v) {
+            SVJFinder::Variation & var = core.variations[v];
+            out << "variation " << var.name << "\ncutflow";
+            for (size_t i = 0; i < var.CutFlow.size(); ++i)
+                out << " " << var.CutFlow[i];
+            size_t selected = 0;
+            for (size_t i = 0; i < var.selectionIndex.size(); ++i)
+                selected += var.selectionIndex[i].size();
+            out << "\nselected " << selected << "\n";
+            for (size_t i = 0; i < var.hists.size(); ++i) {
+                TH1F* h = var.hists[i];
+                out << "hist " << h->GetName() << " " << h->GetNbinsX() << " " << h->GetXaxis()->GetXmin() << " " << h->GetXaxis()->GetXmax() << " " << h->GetEntries();
+                for (int b = 0; b <= h->GetNbinsX() + 1; ++b)
+                    out << " " << h->GetBinContent(b);
+                out << "\n";
+            }
+            for (size_t t = 0; t < var.selectionIndex.size(); ++t) {
+                if (var.selectionIndex[t].empty())
+                    continue;
+                out << "selection " << t;
+                for (size_t i = 0; i < var.selectionIndex[t].size(); ++i)
+                    out << " " << var.selectionIndex[t][i];
+                out << "\n";
+            }
+        }
+        for (size_t t = 0; t < core.outputTrees.size(); ++t)
+            out << "tree " << t << " " << core.outputTrees[t] << "\n";
+        out << "entries " << (core.Sampling() ? core.sampled : Long64_t(core.nMax - core.nMin)) << "\n";
+        out << "output " << core.outputdir << "/" << core.sample << "_output.root\n";
+        return out.str();
+    }
+
+    static vector<string> Split(const string & payload) {
+        vector<string> args;
+        std::stringstream ss(payload);
+        string arg;
+        while (std::getline(ss, arg))
+            args.push_back(arg);
+        return args;
+    }
+
+    static void Log(const string & s) {
+        cout << "SVJselection :: service :: " << s << endl;
+    }
+
+    string path;
+    std::list<Session> sessions;
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include "SVJAnalysis.h"
+#include <memory>
+
+// runs the selection inside the calling process, for PyROOT (see selection/svjsession.py). the
+// results are handed out as references to the core's own buffers, so python can view them as
+// numpy arrays without copying. a view stays valid until the next Run, which may grow (and so
+// move) the buffers behind it
+class SelectionSession {
+public:
+    SelectionSession(string filelist, string sample, string outputdir) : core(filelist, sample, outputdir) {
+        core.recording = true;
+    }
+
+    // settings which shape the results (variationSpec, scanSpec, sketchSize, stageDir, ...) are
+    // read when the first entry is run, and are fixed after that
+    SVJFinder & Config() {
+        return core;
+    }
+
+    // derived variables of selected events are kept unless turned off before the first Run
+    void RecordColumns(bool record) {
+        core.recording = record;
+    }
+
+    Long64_t Entries() {
+        Open();
+        return core.nEvents;
+    }
+
+    // runs the entries [first, last) of the chain; last < 0 means up to the end. returns the
+    // number of entries run
+    Long64_t Run(Long64_t first=0, Long64_t last=-1) {
+        Open();
+        if (last < 0 || last > core.nEvents)
+            last = core.nEvents;
+        first = std::max(first, (Long64_t)0);
+        for (Long64_t entry = first; entry < last; ++entry)
+            selection->Process(entry);
+        return std::max(last - first, (Long64_t)0);
+    }
+
+    // writes the outputs of everything run so far, as the binary would
+    void Write() {
+        Open();
+        core.WriteHists();
+        core.WriteScan();
+        core.WriteSketches();
+        core.WriteColumns();
+        core.WriteSelectionIndex();
+        core.SaveCutFlow();
+    }
+
+    size_t NVariations() {
+        return core.variations.size();
+    }
+
+    const string & VariationName(size_t variation) {
+        return core.variations.at(variation).name;
+    }
+
+    // events passing no cut, then passing each cut in Cuts::CutType order
+    const vector<int> & CutFlow(size_t variation=0) {
+        return core.variations.at(variation).CutFlow;
+    }
+
+    // histograms by name, e.g. "h_Mt"; GetArray holds the bin contents including under/overflow
+    TH1F* Hist(const string & name, size_t variation=0) {
+        vector<TH1F*> & hists = core.variations.at(variation).hists;
+        for (size_t i = 0; i < hists.size(); ++i)
+            if (name == hists[i]->GetName())
+                return hists[i];
+        throw "No histogram '" + name + "'";
+    }
+
+    // input files, in chain order, and the entries of each which passed the selection
+    const vector<string> & Trees() {
+        return core.outputTrees;
+    }
+
+    const vector<size_t> & Selection(size_t tree, size_t variation=0) {
+        return core.variations.at(variation).selectionIndex.at(tree);
+    }
+
+    const vector<string> & ColumnNames() {
+        return core.columnNames;
+    }
+
+    // one row per selected event, in the order the events were run; the rows of Rows give the
+    // input file (index in Trees) and entry of each
+    const vector<double> & Column(const string & name, size_t variation=0) {
+        for (size_t i = 0; i < core.columnNames.size(); ++i)
+            if (core.columnNames[i] == name)
+                return core.variations.at(variation).columns[i];
+        throw "No column '" + name + "'";
+    }
+
+    const vector<pair<size_t, size_t>> & Rows(size_t variation=0) {
+        return core.variations.at(variation).rows;
+    }
+
+    // the rows of Rows as one flat array, tree then entry of each row, for numpy
+    const size_t* RowData(size_t variation=0) {
+        static_assert(sizeof(pair<size_t, size_t>) == 2*sizeof(size_t), "rows are read as pairs of size_t");
+        return reinterpret_cast<const size_t*>(Rows(variation).data());
+    }
+
+    // constituents of the two leading jets of each row (jets 2i and 2i + 1 belong to row i), when
+    // constituentDR is set: one flat column per name in Constituents::Names, and the number of
+    // constituents of each jet
+    const vector<double> & Constituent(const string & name, size_t variation=0) {
+        for (size_t i = 0; i < Constituents::Names.size(); ++i)
+            if (Constituents::Names[i] == name)
+                return core.variations.at(variation).constituents[i];
+        throw "No constituent column '" + name + "'";
+    }
+
+    const vector<size_t> & JetSizes(size_t variation=0) {
+        return core.variations.at(variation).jetSizes;
+    }
+
+private:
+    void Open() {
+        if (selection)
+            return;
+        core.MakeChain();
+        selection.reset(new SVJAnalysis(core));
+        if (core.npy)
+            core.OpenColumns();
+    }
+
+    SVJFinder core;
+    std::unique_ptr<SVJAnalysis> selection;
+};
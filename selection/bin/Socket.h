@@ -0,0 +1,223 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using std::string;
+
+// a tcp (or local unix) connection carrying framed messages: a header line '<type> <payload
+// length>' followed by the payload bytes. errors are thrown as strings, like everywhere else in
+// the selection, also for garbled or oversized messages, so a bad peer only loses its connection
+class Socket {
+public:
+    explicit Socket(int fd=-1) : fd(fd) {}
+
+    ~Socket() {
+        Close();
+    }
+
+    Socket(Socket && other) : fd(other.fd) {
+        other.fd = -1;
+    }
+
+    Socket & operator=(Socket && other) {
+        if (this != &other) {
+            Close();
+            fd = other.fd;
+            other.fd = -1;
+        }
+        return *this;
+    }
+
+    Socket(const Socket &) = delete;
+    Socket & operator=(const Socket &) = delete;
+
+    // listens on all interfaces, so workers on other hosts can connect
+    static Socket Listen(int port) {
+        Socket s(socket(AF_INET, SOCK_STREAM, 0));
+        if (s.fd < 0)
+            throw "Could not create socket: " + string(strerror(errno));
+        int one = 1;
+        setsockopt(s.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(s.fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s.fd, 64) != 0)
+            throw "Could not listen on port " + std::to_string(port) + ": " + strerror(errno);
+        return s;
+    }
+
+    // listens on a unix socket at path, for clients on this host only. a socket file left behind
+    // by a process which is gone is replaced; one with a live listener is not
+    static Socket ListenLocal(const string & path) {
+        sockaddr_un addr = LocalAddress(path);
+        Socket s(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (s.fd < 0)
+            throw "Could not create socket: " + string(strerror(errno));
+        if (bind(s.fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            if (errno != EADDRINUSE)
+                throw "Could not listen on '" + path + "': " + strerror(errno);
+            Socket probe(socket(AF_UNIX, SOCK_STREAM, 0));
+            if (connect(probe.fd, (sockaddr*)&addr, sizeof(addr)) == 0)
+                throw "Something is already listening on '" + path + "'";
+            unlink(path.c_str());
+            if (bind(s.fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+                throw "Could not listen on '" + path + "': " + strerror(errno);
+        }
+        if (listen(s.fd, 16) != 0)
+            throw "Could not listen on '" + path + "': " + strerror(errno);
+        return s;
+    }
+
+    static Socket ConnectLocal(const string & path) {
+        sockaddr_un addr = LocalAddress(path);
+        Socket s(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (s.fd < 0 || connect(s.fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+            throw "Could not connect to '" + path + "'";
+        return s;
+    }
+
+    // connects to 'host:port'
+    static Socket Connect(string address) {
+        size_t colon = address.rfind(':');
+        if (colon == string::npos)
+            throw "Address '" + address + "' is not of the form host:port";
+        string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+        addrinfo hints, *found = nullptr;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+            throw "Could not resolve '" + address + "'";
+        Socket s;
+        for (addrinfo* a = found; a != nullptr && s.fd < 0; a = a->ai_next) {
+            s.fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (s.fd >= 0 && connect(s.fd, a->ai_addr, a->ai_addrlen) != 0)
+                s.Close();
+        }
+        freeaddrinfo(found);
+        if (s.fd < 0)
+            throw "Could not connect to '" + address + "'";
+        s.KeepAlive();
+        return s;
+    }
+
+    Socket Accept() {
+        Socket s(accept(fd, nullptr, nullptr));
+        if (s.fd < 0)
+            throw "Could not accept connection: " + string(strerror(errno));
+        s.KeepAlive();
+        return s;
+    }
+
+    void Send(const string & type, const string & payload="") {
+        string header = type + " " + std::to_string(payload.size()) + "\n";
+        SendAll(header.data(), header.size());
+        SendAll(payload.data(), payload.size());
+    }
+
+    // blocks until a whole message has arrived; returns false if the peer closed the connection
+    bool Receive(string & type, string & payload) {
+        string header;
+        char c;
+        while (true) {
+            ssize_t n = recv(fd, &c, 1, 0);
+            if (n == 0 && header.empty())
+                return false;
+            if (n <= 0)
+                throw string("Connection lost while reading message header");
+            if (c == '\n')
+                break;
+            if (header.size() >= MAX_HEADER)
+                throw "Malformed message header '" + header.substr(0, 32) + "...'";
+            header += c;
+        }
+        size_t space = header.find(' ');
+        if (space == string::npos)
+            throw "Malformed message header '" + header + "'";
+        type = header.substr(0, space);
+        const char* digits = header.c_str() + space + 1;
+        char* end = nullptr;
+        errno = 0;
+        unsigned long long size = std::strtoull(digits, &end, 10);
+        if (!std::isdigit((unsigned char)digits[0]) || *end != '\0' || errno == ERANGE)
+            throw "Malformed message header '" + header + "'";
+        if (size > MAX_PAYLOAD)
+            throw type + " message of " + std::to_string(size) + " bytes is over the limit of " + std::to_string(MAX_PAYLOAD);
+        payload.resize(size);
+        size_t done = 0;
+        while (done < payload.size()) {
+            ssize_t n = recv(fd, &payload[done], payload.size() - done, 0);
+            if (n <= 0)
+                throw "Connection lost while reading " + type + " message";
+            done += n;
+        }
+        return true;
+    }
+
+    // makes a send or receive which gets nowhere for this many seconds fail, so a peer which stops
+    // in the middle of a message cannot block the other end
+    void Timeout(int seconds) {
+        timeval t;
+        t.tv_sec = seconds;
+        t.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &t, sizeof(t));
+    }
+
+    void Close() {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+
+    int fd;
+
+private:
+    // longest header line, and largest payload, accepted from a peer
+    static const size_t MAX_HEADER = 256;
+    static const unsigned long long MAX_PAYLOAD = 1ULL << 32;
+
+    void SendAll(const char* data, size_t size) {
+        while (size > 0) {
+            // MSG_NOSIGNAL: a dead peer is an error here, not a SIGPIPE
+            ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+            if (n <= 0)
+                throw string("Connection lost while sending");
+            data += n;
+            size -= n;
+        }
+    }
+
+    static sockaddr_un LocalAddress(const string & path) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            throw "Socket path '" + path + "' is too long";
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
+    // lets the kernel notice peers on other hosts which vanished without closing the connection.
+    // only a backstop: with default settings that takes about two hours, so the coordinator also
+    // wants heartbeats from its workers
+    void KeepAlive() {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+};
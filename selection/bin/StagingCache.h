@@ -0,0 +1,239 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+// copies upcoming input files from a slow source (e.g. an /eos mount) to a local scratch directory
+// in the background, so the chain reads local copies. files are staged in the order they were
+// prefetched, and the space they take is bounded: once it runs out, copies which have been read
+// and are no longer open are evicted, least recently released first, then copies the readers have
+// passed over. files which are not staged yet when they are needed are read from the source, and
+// no longer staged
+class StagingCache {
+public:
+    StagingCache(string directory, long long capacity) : directory(directory), capacity(capacity) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+            throw "Could not create staging directory '" + directory + "'";
+        copier = std::thread(&StagingCache::Stage, this);
+    }
+
+    // stops copying and removes every staged file
+    ~StagingCache() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        copier.join();
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+            if (it->second.state == Entry::ready)
+                unlink(it->second.local.c_str());
+    }
+
+    // queues files for staging, in the order they will be read
+    void Prefetch(const vector<string> & sources) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < sources.size(); ++i) {
+                if (entries.count(sources[i]))
+                    continue;
+                Entry & e = entries[sources[i]];
+                e.order = prefetched++;
+                e.local = directory + "/" + std::to_string(std::hash<string>()(sources[i])) + "_" + Basename(sources[i]);
+                queue.push_back(sources[i]);
+            }
+        }
+        changed.notify_all();
+    }
+
+    // returns the path to open for a source file, and keeps a staged copy from being evicted until
+    // Release. waits for a copy which is in progress; a file still queued is taken off the queue
+    // and read from the source, as is anything else not staged
+    string Acquire(const string & source) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = entries.find(source);
+        if (it == entries.end())
+            return source;
+        Entry & e = it->second;
+        if (e.order + 1 > passed) {
+            passed = e.order + 1;
+            changed.notify_all();
+        }
+        // the copier may have taken it off the queue already, and be waiting for room
+        if (e.state == Entry::queued) {
+            auto queued = std::find(queue.begin(), queue.end(), source);
+            if (queued != queue.end())
+                queue.erase(queued);
+            e.state = Entry::skipped;
+            return source;
+        }
+        changed.wait(lock, [&e]{ return e.state != Entry::copying; });
+        if (e.state != Entry::ready)
+            return source;
+        if (e.pins++ == 0 && e.read)
+            released.erase(e.position);
+        e.read = true;
+        hits++;
+        return e.local;
+    }
+
+    void Release(const string & source) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(source);
+            if (it == entries.end() || it->second.state != Entry::ready || it->second.pins == 0)
+                return;
+            Entry & e = it->second;
+            if (--e.pins == 0)
+                e.position = released.insert(released.end(), source);
+        }
+        changed.notify_all();
+    }
+
+    // number of Acquire calls answered with a staged copy
+    size_t Hits() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits;
+    }
+
+private:
+    struct Entry {
+        enum State { queued, copying, ready, skipped };
+        string local;
+        long long size = 0;
+        State state = queued;
+        // position in the prefetch order
+        size_t order = 0;
+        int pins = 0;
+        // staged copies are only evicted once they have been read
+        bool read = false;
+        std::list<string>::iterator position;
+    };
+
+    // background thread: stages queued files one at a time
+    void Stage() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            string source = queue.front();
+            queue.pop_front();
+            Entry & e = entries[source];
+
+            struct stat st;
+            if (stat(source.c_str(), &st) != 0 || st.st_size > capacity) {
+                e.state = Entry::skipped;
+                continue;
+            }
+            e.size = st.st_size;
+
+            // make room, waiting for staged files to be read and released if necessary
+            changed.wait(lock, [this, &e]{ return stopping || e.state != Entry::queued || MakeRoom(e.size); });
+            if (stopping)
+                return;
+            if (e.state != Entry::queued)
+                continue;
+
+            e.state = Entry::copying;
+            used += e.size;
+            string local = e.local;
+            lock.unlock();
+            bool copied = Copy(source, local);
+            lock.lock();
+            if (!copied)
+                used -= e.size;
+            e.state = copied ? Entry::ready : Entry::skipped;
+            changed.notify_all();
+        }
+    }
+
+    // evicts released copies, oldest first, until size bytes fit; then unread copies of files
+    // prefetched before the latest one acquired, which the readers have skipped (or will read from
+    // the source again). false if size bytes still do not fit
+    bool MakeRoom(long long size) {
+        while (used + size > capacity && !released.empty()) {
+            Entry & victim = entries[released.front()];
+            released.pop_front();
+            Evict(victim);
+        }
+        for (auto it = entries.begin(); used + size > capacity && it != entries.end(); ++it) {
+            Entry & e = it->second;
+            if (e.state == Entry::ready && !e.read && e.pins == 0 && e.order < passed)
+                Evict(e);
+        }
+        return used + size <= capacity;
+    }
+
+    void Evict(Entry & e) {
+        unlink(e.local.c_str());
+        used -= e.size;
+        e.state = Entry::skipped;
+    }
+
+    // copies through a temporary name, so a partial copy is never opened
+    static bool Copy(const string & from, const string & to) {
+        string temporary = to + ".part";
+        int in = open(from.c_str(), O_RDONLY);
+        int out = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = in >= 0 && out >= 0;
+        vector<char> buffer(1 << 22);
+        while (ok) {
+            ssize_t n = read(in, buffer.data(), buffer.size());
+            if (n <= 0) {
+                ok = n == 0;
+                break;
+            }
+            for (ssize_t done = 0; ok && done < n;) {
+                ssize_t w = write(out, buffer.data() + done, n - done);
+                ok = w > 0;
+                done += w;
+            }
+        }
+        if (in >= 0)
+            close(in);
+        if (out >= 0 && close(out) != 0)
+            ok = false;
+        if (ok && rename(temporary.c_str(), to.c_str()) == 0)
+            return true;
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    static string Basename(const string & path) {
+        size_t slash = path.rfind('/');
+        return slash == string::npos ? path : path.substr(slash + 1);
+    }
+
+    const string directory;
+    const long long capacity;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread copier;
+    bool stopping = false;
+
+    std::map<string, Entry> entries;
+    std::deque<string> queue;
+    // staged copies which are read and no longer open, least recently released first
+    std::list<string> released;
+    long long used = 0;
+    size_t hits = 0;
+    // files prefetched so far, and the prefetch position just past the latest one acquired
+    size_t prefetched = 0, passed = 0;
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include "SVJFinder.h"
+#include "FileStream.h"
+#include "ResultCache.h"
+#include "TROOT.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <deque>
+
+// runs the selection over input files while they are still being produced (see FileStream.h).
+// the stream is followed on the calling thread, and worker threads take whole files off a shared
+// queue as they arrive; each file's results are merged into the sample core as soon as it is
+// done. a file which cannot be opened or fails in the selection is logged and left out, and the
+// stream goes on. outputs are written once the end-of-stream marker has arrived and every file
+// is done
+template<typename analysis>
+class StreamPool {
+public:
+    StreamPool(SVJFinder & config) : config(config) {}
+
+    void Run() {
+        TH1::AddDirectory(kFALSE);
+        if (config.nMin > 0 || config.nMax >= 0)
+            throw string("Entry ranges are only available in serial runs, not when streaming");
+        if (config.Sampling())
+            throw string("Sampling is only available in serial runs, not when streaming");
+        if (config.livePath.size() > 0)
+            throw string("Live snapshots are only available in serial runs, not when streaming");
+        if (config.manifest || config.stageDir.size() > 0)
+            config.log("WARNING :: manifests and staging are ignored when streaming");
+
+        SVJFinder core(SVJFinder::InheritSettings(), config, config.sample);
+        analysis selection(core);
+        if (config.npy)
+            core.OpenColumns();
+        if (config.cacheDir.size() > 0)
+            cache.reset(new ResultCache(config.cacheDir, core));
+        sample = &core;
+
+        FileStream source(config.inputspec);
+        config.log("Following " + config.inputspec + " on " + to_string(config.nThreads) + " threads, until a '" + FileStream::END_MARKER + "' marker");
+        config.log();
+
+        ROOT::EnableThreadSafety();
+        config.start();
+        vector<std::thread> workers;
+        for (int i = 0; i < config.nThreads; ++i)
+            workers.push_back(std::thread(&StreamPool::Work, this));
+
+        string filename;
+        try {
+            while (!failed && source.Next(filename))
+                Add(filename);
+        }
+        catch (string & e) {
+            std::lock_guard<std::mutex> lock(mergeLock);
+            error = e;
+            failed = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            closed = true;
+        }
+        arrived.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+        config.end();
+        config.logt();
+
+        if (!error.empty())
+            throw error;
+
+        config.log();
+        if (bad.size() > 0) {
+            config.log("WARNING :: left out " + to_string(bad.size()) + " of " + to_string(received) + " files:");
+            for (size_t i = 0; i < bad.size(); ++i)
+                config.log("WARNING ::   " + bad[i]);
+            if (bad.size() == received)
+                throw string("No file of the stream could be processed");
+        }
+        config.log("Stream ended after " + to_string(received) + " files; writing outputs for sample " + core.sample);
+        core.MakeOutput();
+        core.WriteHists();
+        core.WriteScan();
+        core.WriteSketches();
+        core.WriteColumns();
+        core.WriteSelectionIndex();
+        core.SaveCutFlow();
+        if (config.debug)
+            core.PrintCutFlow();
+    }
+
+private:
+    // registers a newly arrived file with the sample, and queues it unless its results are cached
+    void Add(const string & filename) {
+        {
+            std::lock_guard<std::mutex> lock(mergeLock);
+            sample->ExpectTree(filename);
+            received++;
+            SVJFinder::Partial p;
+            if (cache && cache->Load(filename, p)) {
+                sample->Merge(p);
+                config.log("Using cached results for file " + to_string(received) + " (" + filename + ")");
+                return;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            queue.push_back(filename);
+        }
+        arrived.notify_one();
+    }
+
+    // the next queued file; false once the stream has closed and the queue is empty
+    bool Next(string & filename) {
+        std::unique_lock<std::mutex> lock(queueLock);
+        arrived.wait(lock, [this]{ return !queue.empty() || closed || failed; });
+        if (queue.empty() || failed)
+            return false;
+        filename = queue.front();
+        queue.pop_front();
+        return true;
+    }
+
+    void Work() {
+        SVJFinder core(SVJFinder::InheritSettings(), config);
+        analysis selection(core);
+        string filename;
+        while (Next(filename)) {
+            SVJFinder::Partial p;
+            try {
+                core.OpenFiles(vector<string>(1, filename));
+                if (core.chain->size() == 0)
+                    throw string("no readable Delphes tree");
+                core.ProcessRange(selection, 0, core.GetEntries());
+                p = core.Export();
+                {
+                    std::lock_guard<std::mutex> lock(mergeLock);
+                    sample->Merge(p);
+                    config.log("Finished file " + to_string(++done) + " of " + to_string(received) + " received (" + filename + ")");
+                }
+            }
+            catch (string & e) {
+                // whatever the file left in the core is dropped with it
+                core.Export();
+                std::lock_guard<std::mutex> lock(mergeLock);
+                bad.push_back(filename + ": " + e);
+                config.log("WARNING :: leaving out " + filename + ": " + e);
+                continue;
+            }
+
+            // the file's results are merged by now, so a cache which cannot be written only costs
+            // the next run a rerun of it
+            try {
+                if (cache)
+                    cache->Store(filename, p);
+            }
+            catch (string & e) {
+                std::lock_guard<std::mutex> lock(mergeLock);
+                config.log("WARNING :: could not cache the results of " + filename + ": " + e);
+            }
+        }
+    }
+
+    SVJFinder & config;
+    SVJFinder* sample = nullptr;
+    std::unique_ptr<ResultCache> cache;
+
+    // files waiting for a worker; closed once the stream has ended
+    std::deque<string> queue;
+    bool closed = false;
+    std::mutex queueLock;
+    std::condition_variable arrived;
+
+    std::atomic<bool> failed{false};
+    size_t received = 0, done = 0;
+    std::mutex mergeLock;
+    string error;
+    // files left out, with the reason
+    vector<string> bad;
+};
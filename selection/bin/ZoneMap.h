@@ -0,0 +1,264 @@
+#pragma once
+#include "Rtypes.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <atomic>
+
+using std::string;
+using std::vector;
+
+// zone maps: for every cluster of an input file, the range of each cut variable over the events
+// of the cluster and the cutflow of the cluster, as found by the runs which processed the file,
+// whole or in ranges (see SVJFinder::ProcessRange). a run over a range stores a piece of the map,
+// and the pieces are joined into the map once they cover the file. a later run can tell from the ranges that no event of a cluster
+// passes a cut whose variable has to lie above (or below) a threshold, and take the events failing
+// at or before that cut from the stored cutflow instead of reading them. the file's zone spans
+// all of its clusters, so a file nothing can pass is skipped in one step. entries are keyed on
+// the identity of the input file (path, size and modification time) and the version of the
+// selection, as in ResultCache
+class ZoneMap {
+public:
+    // how a cut was evaluated: what its variable depends on, and whether it passes for values
+    // above ('>') or below ('<') a threshold, or neither ('-', e.g. for cuts combining others)
+    struct Rule {
+        string variable = "?";
+        char op = '-';
+        double threshold = 0;
+
+        bool operator==(const Rule & other) const {
+            return variable == other.variable && op == other.op && (op == '-' || threshold == other.threshold);
+        }
+    };
+
+    // a range of entries of a file; for every cut, the number of events with a value of its
+    // variable and their smallest and largest values, and the cutflow of the range
+    struct Zone {
+        Long64_t first = 0, last = 0;
+        vector<Long64_t> counts;
+        vector<double> low, high;
+        vector<int> cutflow;
+
+        Zone(size_t cuts=0) : counts(cuts, 0), low(cuts, 0), high(cuts, 0), cutflow(cuts + 1, 0) {}
+
+        void Add(size_t cut, double value) {
+            if (std::isnan(value))
+                return;
+            if (counts[cut] == 0 || value < low[cut])
+                low[cut] = value;
+            if (counts[cut] == 0 || value > high[cut])
+                high[cut] = value;
+            counts[cut]++;
+        }
+
+        void Add(const Zone & other) {
+            first = std::min(first, other.first);
+            last = std::max(last, other.last);
+            for (size_t i = 0; i < counts.size(); ++i) {
+                if (other.counts[i] > 0) {
+                    Add(i, other.low[i]);
+                    Add(i, other.high[i]);
+                    counts[i] += other.counts[i] - 2;
+                }
+            }
+            for (size_t i = 0; i < cutflow.size(); ++i)
+                cutflow[i] += other.cutflow[i];
+        }
+
+        // true if no event of the zone can pass the cut under the rule: every value lies on the
+        // failing side of the threshold. events without a value never had the cut evaluated,
+        // which fails it as well
+        bool Fails(size_t cut, const Rule & rule) const {
+            if (counts[cut] == 0)
+                return true;
+            if (rule.op == '>')
+                return high[cut] <= rule.threshold;
+            if (rule.op == '<')
+                return low[cut] >= rule.threshold;
+            return false;
+        }
+    };
+
+    // the zones of one file, and the rules of the run which found them
+    struct File {
+        Long64_t entries = 0;
+        vector<Rule> rules;
+        vector<Zone> zones;
+        Zone total;
+    };
+
+    // version: of the selection which makes the maps, e.g. SVJFinder::SELECTION_VERSION
+    ZoneMap(string directory, string version) : directory(directory) {
+        path = directory + "/" + Hash(version);
+        MakeDirectory(directory);
+        MakeDirectory(path);
+    }
+
+    // fills f with the zones of a file; false if there are none for its current version
+    bool Load(const string & filename, File & f) {
+        string identity;
+        if (!Identify(filename, identity))
+            return false;
+        std::ifstream in(Entry(identity).c_str());
+        string stored;
+        if (!in.is_open() || !getline(in, stored) || stored != identity)
+            return false;
+        return Read(in, f) && f.total.first == 0 && f.total.last == f.entries;
+    }
+
+    // writes to a temporary file first, so an interrupted run never leaves a truncated entry
+    void Store(const string & filename, const File & f) {
+        string identity;
+        if (!Identify(filename, identity))
+            return;
+        Write(filename, identity, f, Entry(identity));
+    }
+
+    // stores the zones of a range of a file, from a run which only had that range, and joins the
+    // stored pieces of the file into its map once they cover it. pieces found with other rules
+    // are left out. true if the file has a map now
+    bool StorePiece(const string & filename, const File & piece) {
+        string identity;
+        if (piece.zones.empty() || !Identify(filename, identity))
+            return false;
+        string prefix = Hash(identity) + ".";
+        Write(filename, identity, piece, path + "/" + prefix + std::to_string(piece.zones.front().first) + "-" + std::to_string(piece.zones.back().last) + ".piece");
+
+        vector<string> names;
+        DIR* dir = opendir(path.c_str());
+        if (!dir)
+            return false;
+        while (dirent* e = readdir(dir)) {
+            string name = e->d_name;
+            if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > 6 && name.compare(name.size() - 6, 6, ".piece") == 0)
+                names.push_back(name);
+        }
+        closedir(dir);
+
+        // the pieces by their first entry, chained from entry 0 up to the end of the file
+        std::map<Long64_t, File> pieces;
+        for (size_t i = 0; i < names.size(); ++i) {
+            std::ifstream in((path + "/" + names[i]).c_str());
+            string stored;
+            File f;
+            if (getline(in, stored) && stored == identity && Read(in, f) && f.entries == piece.entries && f.rules == piece.rules && !f.zones.empty())
+                pieces[f.total.first] = f;
+        }
+        File whole;
+        whole.entries = piece.entries;
+        whole.rules = piece.rules;
+        Long64_t at = 0;
+        for (auto it = pieces.find(at); it != pieces.end() && at < whole.entries; it = pieces.find(at)) {
+            whole.zones.insert(whole.zones.end(), it->second.zones.begin(), it->second.zones.end());
+            at = it->second.total.last;
+        }
+        if (at != whole.entries)
+            return false;
+        Store(filename, whole);
+        for (size_t i = 0; i < names.size(); ++i)
+            std::remove((path + "/" + names[i]).c_str());
+        return true;
+    }
+
+    const string directory;
+
+private:
+    // the rules and zones after the identity line of an entry; the total spans the zones read
+    static bool Read(std::istream & in, File & f) {
+        size_t nCuts = 0, nZones = 0;
+        string word;
+        if (!(in >> word >> f.entries >> word >> nCuts))
+            return false;
+        f.rules.assign(nCuts, Rule());
+        for (size_t i = 0; i < nCuts; ++i) {
+            Rule & r = f.rules[i];
+            // the variable is bracketed, as it may be empty or hold spaces
+            if (!(in >> r.op >> r.threshold >> std::ws) || !getline(in, r.variable) || r.variable.size() < 2)
+                return false;
+            r.variable = r.variable.substr(1, r.variable.size() - 2);
+        }
+        if (!(in >> word >> nZones))
+            return false;
+        f.zones.assign(nZones, Zone(nCuts));
+        f.total = Zone(nCuts);
+        for (size_t z = 0; z < nZones; ++z) {
+            Zone & zone = f.zones[z];
+            in >> zone.first >> zone.last;
+            for (size_t i = 0; i < nCuts; ++i)
+                in >> zone.counts[i] >> zone.low[i] >> zone.high[i];
+            for (size_t i = 0; i <= nCuts; ++i)
+                in >> zone.cutflow[i];
+            if (z == 0)
+                f.total.first = f.total.last = zone.first;
+            f.total.Add(zone);
+        }
+        return bool(in);
+    }
+
+    void Write(const string & filename, const string & identity, const File & f, const string & entry) {
+        // unique per thread as well, as the workers of two cores may join the pieces of a file at once
+        static std::atomic<size_t> counter{0};
+        string temporary = entry + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+        std::ofstream out(temporary.c_str());
+        out << identity << "\n" << std::setprecision(17);
+        out << "entries " << f.entries << " cuts " << f.rules.size() << "\n";
+        for (size_t i = 0; i < f.rules.size(); ++i)
+            out << f.rules[i].op << " " << f.rules[i].threshold << " [" << f.rules[i].variable << "]\n";
+        out << "zones " << f.zones.size() << "\n";
+        for (size_t z = 0; z < f.zones.size(); ++z) {
+            const Zone & zone = f.zones[z];
+            out << zone.first << " " << zone.last;
+            for (size_t i = 0; i < zone.counts.size(); ++i)
+                out << " " << zone.counts[i] << " " << zone.low[i] << " " << zone.high[i];
+            for (size_t i = 0; i < zone.cutflow.size(); ++i)
+                out << " " << zone.cutflow[i];
+            out << "\n";
+        }
+        out.close();
+        if (!out || std::rename(temporary.c_str(), entry.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw "Could not write zone map for '" + filename + "'";
+        }
+    }
+
+    // 64 bit FNV-1a, as hex
+    static string Hash(const string & s) {
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t i = 0; i < s.size(); ++i) {
+            h ^= (unsigned char)s[i];
+            h *= 1099511628211ULL;
+        }
+        char buffer[17];
+        snprintf(buffer, sizeof(buffer), "%016llx", h);
+        return buffer;
+    }
+
+    bool Identify(const string & filename, string & identity) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0)
+            return false;
+        identity = filename + " " + std::to_string((long long)st.st_size) + " " + std::to_string((long long)st.st_mtime);
+        return true;
+    }
+
+    string Entry(const string & identity) {
+        return path + "/" + Hash(identity) + ".zones";
+    }
+
+    static void MakeDirectory(const string & dir) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            throw "Could not create zone map directory '" + dir + "'";
+    }
+
+    string path;
+};
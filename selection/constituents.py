@@ -0,0 +1,79 @@
+import os
+import numpy as np
+
+# reader for the ragged jet constituents written by the selection with --constituents: one flat
+# .npy file per column, one row per constituent, and an int64 offsets file where jet i holds the rows
+# [offsets[i], offsets[i + 1]). jets 2i and 2i + 1 are the leading jets of row i of the event
+# columns (<name>_MT.npy, <name>_tree.npy, ...), and their constituents are sorted by decreasing
+# pt, so truncating keeps the hardest ones.
+#
+#   from constituents import Constituents
+#   c = Constituents("out", "qcd")
+#   c.padded(100)                       # (jets, 100, 5), as the converter's jet_constituents
+#   for batch in c.batches(100, 4096):  # the same in bounded chunks of jets
+#       ...
+#
+# the files are memory mapped, so only the jets asked for are read
+
+NAMES = ['Eta', 'Phi', 'PT', 'Rapidity', 'Energy']
+JETS_PER_ROW = 2
+
+class Constituents:
+
+    def __init__(self, outputdir=None, name=None, columns=None, offsets=None):
+        """opens <outputdir>/<name>_constituents_*.npy, or wraps flat columns (name -> array) and
+        offsets already in memory"""
+        if columns is None:
+            prefix = os.path.join(outputdir, "{0}_constituents_".format(name))
+            columns = dict((c, np.load(prefix + c + ".npy", mmap_mode='r')) for c in NAMES)
+            offsets = np.load(prefix + "offsets.npy", mmap_mode='r')
+        self.columns = columns
+        self.offsets = np.asarray(offsets, dtype=np.int64)
+
+    @staticmethod
+    def from_sizes(columns, sizes):
+        """from flat columns and the number of constituents of each jet"""
+        offsets = np.zeros(len(sizes) + 1, dtype=np.int64)
+        np.cumsum(sizes, out=offsets[1:])
+        return Constituents(columns=columns, offsets=offsets)
+
+    def __len__(self):
+        return len(self.offsets) - 1
+
+    def sizes(self):
+        """number of constituents of each jet"""
+        return np.diff(self.offsets)
+
+    def jet(self, i, names=NAMES):
+        """the constituents of jet i, (n, len(names))"""
+        a, b = self.offsets[i], self.offsets[i + 1]
+        return np.stack([np.asarray(self.columns[c][a:b]) for c in names], axis=-1)
+
+    def padded(self, n, first=0, last=None, names=NAMES, fill=0.):
+        """jets [first, last) as a dense (jets, n, len(names)) array: the n hardest constituents of
+        each jet, padded with fill"""
+        last = len(self) if last is None else min(last, len(self))
+        first = min(first, last)
+        starts = self.offsets[first:last]
+        keep = np.minimum(self.offsets[first + 1:last + 1] - starts, n)
+        out = np.full((last - first, n, len(names)), fill, dtype=np.float64)
+        if keep.sum() == 0:
+            return out
+        # jet and position within the jet of every kept constituent, and its row in the columns
+        jet = np.repeat(np.arange(last - first), keep)
+        pos = np.arange(keep.sum()) - np.repeat(np.cumsum(keep) - keep, keep)
+        rows = np.repeat(starts - starts[0], keep) + pos
+        base, end = starts[0], starts[-1] + keep[-1]
+        for k,c in enumerate(names):
+            out[jet, pos, k] = np.asarray(self.columns[c][base:end])[rows]
+        return out
+
+    def batches(self, n, size, names=NAMES, fill=0.):
+        """padded(n) in chunks of size jets, so only one chunk is ever in memory"""
+        for first in range(0, len(self), size):
+            yield self.padded(n, first, first + size, names, fill)
+
+    def events(self, n, names=NAMES, fill=0.):
+        """padded(n) as (rows, 2, n, len(names)), one entry per row of the event columns"""
+        p = self.padded(n, names=names, fill=fill)
+        return p.reshape((len(self) // JETS_PER_ROW, JETS_PER_ROW, n, len(names)))
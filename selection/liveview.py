@@ -0,0 +1,139 @@
+import sys
+import time
+import mmap
+import struct
+import argparse
+
+# viewer for the live snapshot a running selection publishes with --live <path> (see
+# bin/LiveSnapshot.h): its progress, cutflow and histograms, read without stopping or slowing it.
+#
+#   python liveview.py /dev/shm/qcd.live                   # progress and cutflow, once
+#   python liveview.py /dev/shm/qcd.live -w 2              # every 2 seconds until the run is over
+#   python liveview.py /dev/shm/qcd.live --hist h_Mt       # and a text plot of a histogram
+#
+#   from liveview import Snapshot
+#   s = Snapshot.read("/dev/shm/qcd.live")
+#   s.cutflow("nominal"), s.hist("h_Mt")                   # lists, bins with under/overflow
+
+# magic, sequence, version, variations, cuts, hists, bins, names offset, names size, data
+# offset, size, entries, done, finished, start time, update time, rate
+_HEADER = struct.Struct("<8s13Q3d")
+_SEQUENCE = 8
+_VERSION = 1
+
+class Snapshot:
+
+    def __init__(self, header, names, data):
+        (_, _, _, nv, nc, nh, nb, _, _, _, _, self.entries, self.done, finished,
+         self.start_time, self.update_time, self.rate) = header
+        self.finished = bool(finished)
+        self.variations, self.cuts, self.hists = [], [], []
+        for line in names.decode("ascii").splitlines():
+            kind, rest = line.split(" ", 1)
+            if kind == "variation":
+                self.variations.append(rest)
+            elif kind == "cut":
+                self.cuts.append(rest)
+            elif kind == "hist":
+                name, bins, low, high = rest.split(" ")
+                self.hists.append((name, int(bins), float(low), float(high)))
+        # per variation: the cutflow, then the bins of every histogram
+        per = nc + 1 + nb
+        self._cutflows, self._bins = {}, {}
+        for v, name in enumerate(self.variations):
+            block = data[8*per*v:8*per*(v + 1)]
+            self._cutflows[name] = list(struct.unpack_from("<{0}q".format(nc + 1), block))
+            bins = struct.unpack_from("<{0}d".format(nb), block, 8*(nc + 1))
+            start, hists = 0, {}
+            for h, b, _, _ in self.hists:
+                hists[h] = list(bins[start:start + b + 2])
+                start += b + 2
+            self._bins[name] = hists
+
+    @staticmethod
+    def read(path, tries=1000):
+        """a consistent copy of the snapshot: the data is kept only if the writer's sequence number
+        was even (no update going on) and the same before and after copying it"""
+        with open(path, "rb") as f:
+            m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        try:
+            for _ in range(tries):
+                before = struct.unpack_from("<Q", m, _SEQUENCE)[0]
+                if before % 2 == 1:
+                    time.sleep(0.001)
+                    continue
+                header = _HEADER.unpack_from(m, 0)
+                if header[0].rstrip(b"\0") != b"SVJLIVE" or header[2] != _VERSION:
+                    raise ValueError("{0} is not a live selection snapshot".format(path))
+                names = m[header[7]:header[7] + header[8]]
+                data = m[header[9]:header[10]]
+                if struct.unpack_from("<Q", m, _SEQUENCE)[0] == before:
+                    return Snapshot(header, names, data)
+            raise RuntimeError("no consistent snapshot of {0} after {1} tries".format(path, tries))
+        finally:
+            m.close()
+
+    def cutflow(self, variation="nominal"):
+        return self._cutflows[variation]
+
+    def hist(self, name, variation="nominal"):
+        return self._bins[variation][name]
+
+    def progress(self):
+        elapsed = self.update_time - self.start_time
+        line = "{0} of {1} entries ({2:.1f}%), {3:.0f}/s".format(self.done, self.entries, 100.*self.done/max(self.entries, 1), self.rate)
+        if self.finished:
+            return line + ", finished after {0:.0f}s".format(elapsed)
+        left = (self.entries - self.done)/self.rate if self.rate > 0 else float("nan")
+        return line + ", {0:.0f}s in, ~{1:.0f}s left, updated {2:.0f}s ago".format(elapsed, left, time.time() - self.update_time)
+
+    def cutflow_table(self, variation="nominal"):
+        cf = self.cutflow(variation)
+        rows = ["{0:>20}{1:>12}{2:>10}{3:>10}".format("CutFlow", "N", "Abs Eff", "Rel Eff")]
+        for i, name in enumerate(["None"] + self.cuts):
+            abs_eff = 100.*cf[i]/cf[0] if cf[0] > 0 else 0.
+            rel_eff = 100.*cf[i]/cf[i - 1] if i > 0 and cf[i - 1] > 0 else 100. if i == 0 else 0.
+            rows.append("{0:>20}{1:>12}{2:>10.2f}{3:>10.2f}".format(name, cf[i], abs_eff, rel_eff))
+        return "\n".join(rows)
+
+    def hist_plot(self, name, variation="nominal", width=60, rows=25):
+        """the histogram as text, merged into at most rows bars"""
+        _, bins, low, high = [h for h in self.hists if h[0] == name][0]
+        content = self.hist(name, variation)[1:-1]
+        step = (bins + rows - 1)//rows
+        merged = [sum(content[i:i + step]) for i in range(0, bins, step)]
+        top = max(max(merged), 1e-300)
+        width_bin = (high - low)/bins
+        out = ["{0} ({1}), underflow {2:g}, overflow {3:g}".format(name, variation, self.hist(name, variation)[0], self.hist(name, variation)[-1])]
+        for k, c in enumerate(merged):
+            out.append("{0:>10.4g} |{1:<{2}} {3:g}".format(low + k*step*width_bin, "#"*int(round(width*c/top)), width, c))
+        return "\n".join(out)
+
+def main():
+    parser = argparse.ArgumentParser(description="show the live snapshot of a running selection")
+    parser.add_argument("path", help="snapshot file given to the selection with --live")
+    parser.add_argument("-w", "--watch", type=float, default=0, help="refresh every this many seconds until the run is over")
+    parser.add_argument("-v", "--variation", default=None, help="only show this variation")
+    parser.add_argument("--hist", action="append", default=[], help="also plot this histogram (repeatable)")
+    args = parser.parse_args()
+
+    while True:
+        s = Snapshot.read(args.path)
+        if args.watch > 0:
+            sys.stdout.write("\033[2J\033[H")
+        print(s.progress())
+        for v in ([args.variation] if args.variation else s.variations):
+            print("")
+            if len(s.variations) > 1:
+                print("Variation: " + v)
+            print(s.cutflow_table(v))
+            for h in args.hist:
+                print("")
+                print(s.hist_plot(h, v))
+        sys.stdout.flush()
+        if args.watch <= 0 or s.finished:
+            break
+        time.sleep(args.watch)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+import os
+import numpy as np
+import ROOT as rt
+from constituents import Constituents, NAMES as CONSTITUENT_NAMES
+
+# in-process selection: the C++ selection is compiled into this process through PyROOT, and its
+# results are numpy views of the C++ buffers, with no subprocess or files in between.
+#
+#   from svjsession import Session
+#   s = Session("qcd_filelist.txt", "qcd", "out", variations="variations.txt")
+#   s.run(0, 100000)
+#   s.cutflow()             # int32 view of the cutflow
+#   s.column("MT")          # float64 view, one row per selected event
+#   s.rows()                # (tree, entry) of each row, as an (n, 2) uint64 view
+#
+# views stay valid until the next run, which may move the buffers behind them; copy them
+# (np.array(view)) to keep them across runs
+
+_BIN = os.path.join(os.path.dirname(os.path.abspath(__file__)), "bin")
+_DECLARED = False
+
+def _declare():
+    global _DECLARED
+    if _DECLARED:
+        return
+    if "DELPHES_DIR" in os.environ:
+        rt.gSystem.Load("{}/lib/libDelphes.so".format(os.environ["DELPHES_DIR"]))
+    # SVJAnalysis.h uses DataFormats/Math from the cmssw release
+    for base in ["CMSSW_BASE", "CMSSW_RELEASE_BASE"]:
+        if base in os.environ:
+            rt.gInterpreter.AddIncludePath(os.path.join(os.environ[base], "src"))
+    rt.gInterpreter.AddIncludePath(_BIN)
+    rt.gInterpreter.Declare('#include "SelectionSession.h"')
+    _DECLARED = True
+
+def _view(vec, dtype):
+    """numpy view of a std::vector, without copying"""
+    n = int(vec.size())
+    if n == 0:
+        return np.zeros(0, dtype=dtype)
+    buf = vec.data()
+    if hasattr(buf, "reshape"):
+        buf.reshape((n,))
+    return np.frombuffer(buf, dtype=dtype, count=n)
+
+class Session:
+
+    # keyword settings, as the binary's flags
+    SETTINGS = {
+        "variations": "variationSpec",
+        "scan": "scanSpec",
+        "sketch": "sketchSize",
+        "stage": "stageDir",
+        "npy": "npy",
+        "constituents": "constituentDR",
+    }
+
+    def __init__(self, filelist, name, outputdir, record=True, **settings):
+        _declare()
+        self.session = rt.SelectionSession(filelist, name, outputdir)
+        self.session.RecordColumns(record)
+        config = self.session.Config()
+        for key,value in settings.items():
+            setattr(config, self.SETTINGS[key], value)
+
+    def entries(self):
+        return self.session.Entries()
+
+    def run(self, first=0, last=-1):
+        return self.session.Run(first, last)
+
+    def write(self):
+        self.session.Write()
+
+    def variations(self):
+        return [str(self.session.VariationName(i)) for i in range(self.session.NVariations())]
+
+    def cutflow(self, variation=0):
+        return _view(self.session.CutFlow(variation), np.int32)
+
+    def hist(self, name, variation=0):
+        """bin contents of a histogram including under/overflow, and its bin edges"""
+        h = self.session.Hist(name, variation)
+        n = h.GetNbinsX()
+        buf = h.GetArray()
+        if hasattr(buf, "reshape"):
+            buf.reshape((n + 2,))
+        edges = np.linspace(h.GetXaxis().GetXmin(), h.GetXaxis().GetXmax(), n + 1)
+        return np.frombuffer(buf, dtype=np.float32, count=n + 2), edges
+
+    def trees(self):
+        return [str(t) for t in self.session.Trees()]
+
+    def selection(self, tree, variation=0):
+        """selected entries of input file number tree"""
+        return _view(self.session.Selection(tree, variation), np.uint64)
+
+    def columns(self):
+        return [str(c) for c in self.session.ColumnNames()] + ["tree", "entry"]
+
+    def column(self, name, variation=0):
+        """a derived variable, or 'tree' / 'entry': the input file (index in trees()) and the
+        entry within it of each row"""
+        if name in ("tree", "entry"):
+            return self.rows(variation)[:, 0 if name == "tree" else 1]
+        return _view(self.session.Column(name, variation), np.float64)
+
+    def rows(self, variation=0):
+        """input file (index in trees()) and entry of each row of the columns, as an (n, 2) view"""
+        n = int(self.session.Rows(variation).size())
+        if n == 0:
+            return np.zeros((0, 2), dtype=np.uint64)
+        buf = self.session.RowData(variation)
+        if hasattr(buf, "reshape"):
+            buf.reshape((2*n,))
+        return np.frombuffer(buf, dtype=np.uint64, count=2*n).reshape((n, 2))
+
+    def constituents(self, variation=0):
+        """ragged constituents of the two leading jets of each row, with constituents=<dR> set;
+        see constituents.py"""
+        columns = dict((c, _view(self.session.Constituent(c, variation), np.float64)) for c in CONSTITUENT_NAMES)
+        return Constituents.from_sizes(columns, _view(self.session.JetSizes(variation), np.uint64))
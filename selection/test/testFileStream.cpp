@@ -0,0 +1,80 @@
+#include "../bin/FileStream.h"
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+
+// a list file with a line still being written, and a directory fed by a producer thread which
+// renames finished files into place: every complete file comes out once, in order, nothing
+// half-written or hidden does, and both end at the marker
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static void Write(const string & path, const string & text, std::ios::openmode mode=std::ios::trunc) {
+    std::ofstream out(path.c_str(), std::ios::out | mode);
+    out << text;
+}
+
+static void List(const string & directory) {
+    string list = directory + "/files.txt";
+    Write(list, "a.root\n# a comment\nb.ro");
+    FileStream stream(list, 0.01);
+    string f;
+    Check(stream.Next(f) && f == "a.root", "list: first complete line");
+    std::thread producer([&list]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Write(list, "ot\na.root\nc.root\nEND\nd.root\n", std::ios::app);
+    });
+    Check(stream.Next(f) && f == "b.root", "list: a line finished later");
+    Check(stream.Next(f) && f == "c.root", "list: names are handed out once");
+    Check(!stream.Next(f) && stream.Ended(), "list: ends at the marker");
+    producer.join();
+}
+
+static void Directory(const string & directory) {
+    string dir = directory + "/files";
+    mkdir(dir.c_str(), 0755);
+    Write(dir + "/a.root", "closed");
+    Write(dir + "/.b.root", "still being written");
+    Write(dir + "/c.root.part", "still being written");
+    Write(dir + "/notes.txt", "not an input");
+    FileStream stream(dir, 0.01);
+    string f;
+    Check(stream.Next(f) && f == dir + "/a.root", "directory: a visible file is complete");
+    std::thread producer([&dir]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::rename((dir + "/c.root.part").c_str(), (dir + "/c.root").c_str());
+        std::rename((dir + "/.b.root").c_str(), (dir + "/b.root").c_str());
+        Write(dir + "/END", "");
+    });
+    vector<string> got;
+    while (stream.Next(f))
+        got.push_back(f);
+    producer.join();
+    std::sort(got.begin(), got.end());
+    Check(got.size() == 2 && got[0] == dir + "/b.root" && got[1] == dir + "/c.root", "directory: renamed files, each once, before the end");
+    Check(stream.Ended(), "directory: ends at the marker");
+    for (const char* name : {"a.root", "b.root", "c.root", "notes.txt", "END"})
+        std::remove((dir + "/" + name).c_str());
+    rmdir(dir.c_str());
+}
+
+int main() {
+    char directory[] = "/tmp/testFileStreamXXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        return 1;
+    List(directory);
+    Directory(directory);
+    std::remove((string(directory) + "/files.txt").c_str());
+    rmdir(directory);
+
+    if (failures == 0)
+        std::cout << "testFileStream: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
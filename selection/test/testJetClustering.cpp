@@ -0,0 +1,139 @@
+#include "../bin/JetClustering.h"
+#include <iostream>
+#include <random>
+
+// random events clustered with every algorithm at small and large radii, including radii beyond
+// 2 pi / 3 where fewer than three phi tiles fit, against a brute force clustering which compares
+// every pair at every step: the same jets have to come out, and none below ptMin
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+struct Particle {
+    double px, py, pz, E;
+
+    double Pt2() const {
+        return px*px + py*py;
+    }
+
+    double Rap() const {
+        return 0.5*std::log((E + pz)/(E - pz));
+    }
+
+    double Phi() const {
+        return std::atan2(py, px);
+    }
+};
+
+// d_ij = min(kt_i^2p, kt_j^2p) dR_ij^2 / R^2 and d_iB = kt_i^2p over all pairs, merging or
+// finishing the smallest until nothing is left
+static vector<TLorentzVector> BruteForce(vector<Particle> p, double R, JetClustering::Algorithm algorithm, double ptMin) {
+    auto mom = [algorithm](const Particle & a) {
+        return algorithm == JetClustering::antikt ? 1./a.Pt2() : algorithm == JetClustering::kt ? a.Pt2() : 1.;
+    };
+    vector<TLorentzVector> jets;
+    while (!p.empty()) {
+        double best = 1e300;
+        int bi = -1, bj = -1;
+        for (size_t i = 0; i < p.size(); ++i) {
+            if (mom(p[i]) < best) {
+                best = mom(p[i]);
+                bi = i;
+                bj = -1;
+            }
+            for (size_t j = i + 1; j < p.size(); ++j) {
+                double dphi = std::fabs(p[i].Phi() - p[j].Phi());
+                if (dphi > M_PI)
+                    dphi = 2*M_PI - dphi;
+                double drap = p[i].Rap() - p[j].Rap();
+                double d = std::min(mom(p[i]), mom(p[j]))*(drap*drap + dphi*dphi)/(R*R);
+                if (d < best) {
+                    best = d;
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+        if (bj < 0) {
+            TLorentzVector jet;
+            jet.SetPxPyPzE(p[bi].px, p[bi].py, p[bi].pz, p[bi].E);
+            if (jet.Pt() >= ptMin)
+                jets.push_back(jet);
+        }
+        else {
+            p.push_back(Particle{p[bi].px + p[bj].px, p[bi].py + p[bj].py, p[bi].pz + p[bj].pz, p[bi].E + p[bj].E});
+            p.erase(p.begin() + bj);
+        }
+        p.erase(p.begin() + bi);
+    }
+    std::sort(jets.begin(), jets.end(), [](const TLorentzVector & a, const TLorentzVector & b) { return a.Pt() > b.Pt(); });
+    return jets;
+}
+
+static vector<Particle> Event(std::mt19937 & rng, size_t n) {
+    std::exponential_distribution<double> pt(0.1);
+    std::uniform_real_distribution<double> rap(-4, 4), phi(-M_PI, M_PI);
+    vector<Particle> p;
+    for (size_t i = 0; i < n; ++i) {
+        double t = 0.5 + pt(rng), y = rap(rng), f = phi(rng), m = 0.1;
+        double mt = std::sqrt(t*t + m*m);
+        p.push_back(Particle{t*std::cos(f), t*std::sin(f), mt*std::sinh(y), mt*std::cosh(y)});
+    }
+    return p;
+}
+
+static bool Same(const vector<TLorentzVector> & a, const vector<TLorentzVector> & b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        double scale = std::max(1., a[i].E());
+        if (std::fabs(a[i].Px() - b[i].Px()) > 1e-9*scale || std::fabs(a[i].Py() - b[i].Py()) > 1e-9*scale ||
+            std::fabs(a[i].Pz() - b[i].Pz()) > 1e-9*scale || std::fabs(a[i].E() - b[i].E()) > 1e-9*scale)
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    std::mt19937 rng(12345);
+    const JetClustering::Algorithm algorithms[] = {JetClustering::antikt, JetClustering::kt, JetClustering::cambridge};
+    const double radii[] = {0.4, 0.8, 1.5, 2.5, 3.5};
+    for (int e = 0; e < 3; ++e) {
+        vector<Particle> p = Event(rng, 100);
+        vector<TLorentzVector> particles(p.size());
+        for (size_t i = 0; i < p.size(); ++i)
+            particles[i].SetPxPyPzE(p[i].px, p[i].py, p[i].pz, p[i].E);
+        for (JetClustering::Algorithm a : algorithms) {
+            for (double R : radii) {
+                for (double ptMin : {0., 20.}) {
+                    vector<TLorentzVector> jets = JetClustering(R, a, ptMin).Cluster(particles);
+                    string what = JetClustering::ShortName(a, R) + " ptMin=" + std::to_string(int(ptMin)) + " event " + std::to_string(e);
+                    Check(Same(jets, BruteForce(p, R, a, ptMin)), what + " matches brute force");
+                    for (size_t i = 0; i < jets.size(); ++i)
+                        Check(jets[i].Pt() >= ptMin, what + " keeps only jets above ptMin");
+                }
+            }
+        }
+    }
+
+    Check(JetClustering(0.4).Cluster(vector<TLorentzVector>()).empty(), "no particles give no jets");
+
+    bool thrown = false;
+    try {
+        JetClustering(0.);
+    }
+    catch (string &) {
+        thrown = true;
+    }
+    Check(thrown, "a radius of zero is rejected");
+
+    if (failures == 0)
+        std::cout << "testJetClustering: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include "../bin/SelectionSession.h"
+#include "TFile.h"
+#include "TTree.h"
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+// two events with the same hard jets, one with an isolated electron: the lepton-vetoed event
+// still runs every cut for the N-1 histograms, but stays out of the pre- and post-pt histograms,
+// which only take the event without the electron
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// a flat tree with the leaves the selection reads, in place of delphes output
+static void WriteInput(const string & path) {
+    TFile f(path.c_str(), "RECREATE");
+    TTree tree("Delphes", "Delphes");
+    Int_t nJets = 2, nElectrons = 0, nMuons = 0;
+    Float_t jetPt[2] = {1000, 900}, jetEta[2] = {0.1, 0.2}, jetPhi[2] = {0, 3}, jetMass[2] = {50, 40};
+    Float_t electronPt[1] = {50}, electronEta[1] = {0}, electronIso[1] = {0.1};
+    Float_t muonPt[1] = {0}, muonEta[1] = {0}, muonIso[1] = {0};
+    Float_t met = 800, metPhi = 1.5;
+    tree.Branch("Jet_size", &nJets, "Jet_size/I");
+    tree.Branch("Jet.PT", jetPt, "Jet.PT[Jet_size]/F");
+    tree.Branch("Jet.Eta", jetEta, "Jet.Eta[Jet_size]/F");
+    tree.Branch("Jet.Phi", jetPhi, "Jet.Phi[Jet_size]/F");
+    tree.Branch("Jet.Mass", jetMass, "Jet.Mass[Jet_size]/F");
+    tree.Branch("Electron_size", &nElectrons, "Electron_size/I");
+    tree.Branch("Electron.PT", electronPt, "Electron.PT[Electron_size]/F");
+    tree.Branch("Electron.Eta", electronEta, "Electron.Eta[Electron_size]/F");
+    tree.Branch("Electron.IsolationVarRhoCorr", electronIso, "Electron.IsolationVarRhoCorr[Electron_size]/F");
+    tree.Branch("MuonLoose_size", &nMuons, "MuonLoose_size/I");
+    tree.Branch("MuonLoose.PT", muonPt, "MuonLoose.PT[MuonLoose_size]/F");
+    tree.Branch("MuonLoose.Eta", muonEta, "MuonLoose.Eta[MuonLoose_size]/F");
+    tree.Branch("MuonLoose.IsolationVarRhoCorr", muonIso, "MuonLoose.IsolationVarRhoCorr[MuonLoose_size]/F");
+    tree.Branch("MissingET.MET", &met, "MissingET.MET/F");
+    tree.Branch("MissingET.Phi", &metPhi, "MissingET.Phi/F");
+    nElectrons = 1;
+    tree.Fill();
+    nElectrons = 0;
+    tree.Fill();
+    f.Write();
+}
+
+int main() {
+    char directory[] = "/tmp/testLeptonVetoXXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        return 1;
+    string input = string(directory) + "/input.root", list = string(directory) + "/files.txt";
+    WriteInput(input);
+    std::ofstream(list.c_str()) << input << "\n";
+
+    {
+        TH1::AddDirectory(kFALSE);
+        SelectionSession session(list, "test", directory);
+        Check(session.Run() == 2, "both entries run");
+        const vector<int> & cutflow = session.CutFlow();
+        Check(cutflow[0] == 2 && cutflow[1] == 1, "the electron fails the lepton veto");
+        Check(session.Hist("h_post_1pt")->GetEntries() == 1 && session.Hist("h_post_2pt")->GetEntries() == 1, "post-pt histograms take the event without a lepton only");
+        Check(session.Hist("h_pre_1pt")->GetEntries() == 1 && session.Hist("h_pre_2pt")->GetEntries() == 1, "pre-pt histograms take the event without a lepton only");
+        Check(session.Hist("h_n1_leptons")->GetEntries() == 2, "the lepton N-1 histogram takes both");
+    }
+
+    std::system(("rm -rf " + string(directory)).c_str());
+
+    if (failures == 0)
+        std::cout << "testLeptonVeto: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include "Rtypes.h"
+#include "../bin/NpyWriter.h"
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+
+// columns of doubles and of int64, longer than a write block, read back as numpy would: the
+// header names the dtype and final shape and is padded to 64 bytes, and the data follows it
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static string ReadFile(const string & path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+template<typename T>
+static void CheckColumn(const string & path, const string & descr, size_t n) {
+    string bytes = ReadFile(path);
+    Check(bytes.size() == 128 + n*sizeof(T), path + ": size");
+    if (bytes.size() < 128)
+        return;
+    Check(bytes.compare(0, 8, string("\x93NUMPY\x01\x00", 8)) == 0, path + ": magic and version");
+    size_t length = (unsigned char)bytes[8] | ((unsigned char)bytes[9] << 8);
+    Check(10 + length == 128 && bytes[127] == '\n', path + ": header length");
+    string header = bytes.substr(10, length);
+    Check(header.find("'descr': '" + descr + "'") != string::npos, path + ": dtype " + descr);
+    Check(header.find("'shape': (" + std::to_string(n) + ",)") != string::npos, path + ": shape");
+    const T* data = reinterpret_cast<const T*>(bytes.data() + 128);
+    bool values = true;
+    for (size_t i = 0; i < n && 128 + (i + 1)*sizeof(T) <= bytes.size(); ++i)
+        values = values && data[i] == T(i)*T(3);
+    Check(values, path + ": values");
+}
+
+int main() {
+    char directory[] = "/tmp/testNpyWriterXXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        return 1;
+    string doubles = string(directory) + "/doubles.npy", integers = string(directory) + "/integers.npy", empty = string(directory) + "/empty.npy";
+    const size_t n = 100000;
+    {
+        NpyWriter<> d(doubles);
+        NpyWriter<Long64_t> i(integers);
+        NpyWriter<> e(empty);
+        for (size_t k = 0; k < n; ++k) {
+            d.Append(k*3.);
+            i.Append(Long64_t(k)*3);
+        }
+        Check(d.Rows() == n && i.Rows() == n, "rows are counted before closing");
+        d.Close();
+        // i and e are closed by their destructors
+    }
+    CheckColumn<double>(doubles, "<f8", n);
+    CheckColumn<Long64_t>(integers, "<i8", n);
+    CheckColumn<double>(empty, "<f8", 0);
+
+    bool thrown = false;
+    try {
+        NpyWriter<> w(string(directory) + "/missing/column.npy");
+    }
+    catch (string &) {
+        thrown = true;
+    }
+    Check(thrown, "an unwritable path is rejected");
+
+    std::remove(doubles.c_str());
+    std::remove(integers.c_str());
+    std::remove(empty.c_str());
+    rmdir(directory);
+
+    if (failures == 0)
+        std::cout << "testNpyWriter: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
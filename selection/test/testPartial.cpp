@@ -0,0 +1,88 @@
+#include "../bin/SVJFinder.h"
+#include <iostream>
+
+// partials of two ranges of the same file and one of another file, written out and read back,
+// then added up: every count is summed, and rows and selected entries stay with their tree
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static SVJFinder::Partial Make(vector<string> trees, int passed, double column, size_t entry) {
+    SVJFinder::Partial p;
+    p.trees = trees;
+    p.variations.resize(1);
+    SVJFinder::Partial::Results & r = p.variations[0];
+    r.cutflow = {10, passed};
+    r.hists = {{0, 1, 2, 0}};
+    r.histEntries = {3};
+    r.selection.assign(trees.size(), vector<size_t>());
+    r.selection.back().push_back(entry);
+    r.scan = {1, 1};
+    r.columns = {{column}};
+    r.rows = {pair<size_t, size_t>(trees.size() - 1, entry)};
+    r.constituents = {{0.5, -0.5}};
+    r.jetSizes = {1, 1};
+    return p;
+}
+
+static SVJFinder::Partial RoundTrip(const SVJFinder::Partial & p) {
+    std::stringstream ss;
+    p.Write(ss);
+    return SVJFinder::Partial::Read(ss);
+}
+
+int main() {
+    SVJFinder::Partial a = RoundTrip(Make({"a.root"}, 4, 1.5, 7));
+    SVJFinder::Partial b = RoundTrip(Make({"b.root"}, 2, 2.5, 3));
+    SVJFinder::Partial c = RoundTrip(Make({"a.root"}, 1, 3.5, 20));
+
+    Check(a.trees == vector<string>({"a.root"}), "trees survive a round trip");
+    Check(a.variations[0].cutflow == vector<int>({10, 4}), "cutflow survives a round trip");
+    Check(a.variations[0].columns[0] == vector<double>({1.5}), "columns survive a round trip");
+    Check(a.variations[0].constituents[0] == vector<double>({0.5, -0.5}), "constituents survive a round trip");
+
+    SVJFinder::Partial sum;
+    sum.Add(a);
+    sum.Add(b);
+    sum.Add(c);
+    const SVJFinder::Partial::Results & r = sum.variations[0];
+    Check(sum.trees == vector<string>({"a.root", "b.root"}), "trees are joined");
+    Check(r.cutflow == vector<int>({30, 7}), "cutflows are summed");
+    Check(r.hists[0] == vector<double>({0, 3, 6, 0}) && r.histEntries[0] == 9, "histograms are summed");
+    Check(r.scan == vector<double>({3, 3}), "scans are summed");
+    Check(r.columns[0] == vector<double>({1.5, 2.5, 3.5}), "columns are appended");
+    Check(r.rows.size() == 3 && r.rows[1] == pair<size_t, size_t>(1, 3) && r.rows[2] == pair<size_t, size_t>(0, 20), "rows point at their own tree");
+    Check(r.selection.size() == 2 && r.selection[0] == vector<size_t>({7, 20}) && r.selection[1] == vector<size_t>({3}), "selected entries stay with their tree");
+    Check(r.jetSizes.size() == 6 && r.constituents[0].size() == 6, "constituents are appended");
+
+    // the per-node replicas of a pooled run: summaries add up without trees or rows
+    SVJFinder::Partial summary;
+    summary.Add(a.Summary());
+    summary.Add(b.Summary());
+    const SVJFinder::Partial::Results & sr = summary.variations[0];
+    Check(summary.trees.empty() && sr.columns.empty() && sr.rows.empty() && sr.selection.empty(), "a summary carries no rows");
+    Check(sr.cutflow == vector<int>({20, 6}) && sr.histEntries[0] == 6, "summaries are summed");
+
+    std::stringstream truncated;
+    sum.Write(truncated);
+    string bytes = truncated.str();
+    std::stringstream cut(bytes.substr(0, bytes.size() - 1));
+    bool thrown = false;
+    try {
+        SVJFinder::Partial::Read(cut);
+    }
+    catch (string &) {
+        thrown = true;
+    }
+    Check(thrown, "a truncated partial is rejected");
+
+    if (failures == 0)
+        std::cout << "testPartial: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "../bin/QuantileSketch.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+// a shuffled 0..N-1 fed to one sketch, and in four shards to four sketches which are merged:
+// both keep the count and extremes exactly and the quantiles to within the rank error, and
+// survive the flat form written to the outputs
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// quantiles of 0..n-1 are known exactly; allow twice the nominal rank error of the sketch
+static void CheckQuantiles(const QuantileSketch & s, long long n, const string & what) {
+    Check(s.Count() == n, what + ": count");
+    Check(s.Min() == 0 && s.Max() == n - 1, what + ": extremes");
+    for (double q = 0.05; q < 1; q += 0.05) {
+        double error = std::abs(s.Quantile(q) - q*n)/n;
+        Check(error < 2*1.7/200, what + ": quantile " + std::to_string(q) + " off by " + std::to_string(error));
+        Check(std::abs(s.Rank(q*n) - q) < 2*1.7/200, what + ": rank at " + std::to_string(q));
+    }
+}
+
+int main() {
+    const long long n = 200000;
+    vector<double> values(n);
+    for (long long i = 0; i < n; ++i)
+        values[i] = i;
+    std::mt19937 random(1);
+    std::shuffle(values.begin(), values.end(), random);
+
+    QuantileSketch whole;
+    vector<QuantileSketch> shards(4);
+    for (long long i = 0; i < n; ++i) {
+        whole.Add(values[i]);
+        shards[i % 4].Add(values[i]);
+    }
+    CheckQuantiles(whole, n, "one sketch");
+
+    QuantileSketch merged;
+    for (size_t i = 0; i < shards.size(); ++i)
+        merged.Merge(shards[i]);
+    CheckQuantiles(merged, n, "merged shards");
+    Check(merged.ToVector().size() < 20*200, "a sketch stays small");
+
+    QuantileSketch restored = QuantileSketch::FromVector(merged.ToVector());
+    CheckQuantiles(restored, n, "flat round trip");
+    Check(restored.Quantile(0.5) == merged.Quantile(0.5), "flat round trip keeps the median");
+
+    bool thrown = false;
+    try {
+        vector<double> flat = merged.ToVector();
+        flat.pop_back();
+        QuantileSketch::FromVector(flat);
+    }
+    catch (string &) {
+        thrown = true;
+    }
+    Check(thrown, "a truncated sketch is rejected");
+
+    if (failures == 0)
+        std::cout << "testQuantileSketch: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
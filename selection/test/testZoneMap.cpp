@@ -0,0 +1,99 @@
+#include "../bin/ZoneMap.h"
+#include <iostream>
+#include <cstdlib>
+
+// zones keep the range of each cut variable and add up; a cut fails a zone only if every value
+// lies on the failing side of its threshold. maps are stored and loaded per selection version,
+// and the pieces of a file run range by range make up its map once they cover it
+
+static int failures = 0;
+
+static void Check(bool ok, const string & what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static ZoneMap::Rule MakeRule(char op, double threshold) {
+    ZoneMap::Rule r;
+    r.variable = "x";
+    r.op = op;
+    r.threshold = threshold;
+    return r;
+}
+
+// a zone of two cuts over [first, last): values of cut 0, and none of cut 1
+static ZoneMap::Zone MakeZone(Long64_t first, Long64_t last, vector<double> values) {
+    ZoneMap::Zone zone(2);
+    zone.first = first;
+    zone.last = last;
+    for (size_t i = 0; i < values.size(); ++i)
+        zone.Add(0, values[i]);
+    zone.cutflow = {int(last - first), int(values.size()), 0};
+    return zone;
+}
+
+static void Zones() {
+    ZoneMap::Zone a = MakeZone(0, 10, {3, 1, NAN, 2});
+    Check(a.counts[0] == 3 && a.low[0] == 1 && a.high[0] == 3, "zone: range of the values, without nan");
+    Check(a.Fails(0, MakeRule('>', 3)) && !a.Fails(0, MakeRule('>', 2.5)), "zone: '>' fails only with every value at or below");
+    Check(a.Fails(0, MakeRule('<', 1)) && !a.Fails(0, MakeRule('<', 1.5)), "zone: '<' fails only with every value at or above");
+    Check(!a.Fails(0, MakeRule('-', 0)), "zone: a cut without a threshold never fails");
+    Check(a.Fails(1, MakeRule('>', 0)), "zone: a cut never evaluated fails");
+
+    ZoneMap::Zone b = MakeZone(10, 20, {5, 4});
+    a.Add(b);
+    Check(a.first == 0 && a.last == 20, "zone: spans both");
+    Check(a.counts[0] == 5 && a.low[0] == 1 && a.high[0] == 5, "zone: ranges are joined and counts summed");
+    Check(a.counts[1] == 0, "zone: a cut without values stays without");
+    Check(a.cutflow == vector<int>({20, 6, 0}), "zone: cutflows are summed");
+}
+
+static ZoneMap::File MakeFile(Long64_t entries, vector<ZoneMap::Zone> zones) {
+    ZoneMap::File f;
+    f.entries = entries;
+    f.rules = {MakeRule('>', 2), MakeRule('-', 0)};
+    f.zones = zones;
+    return f;
+}
+
+static void Maps(const string & directory) {
+    string input = directory + "/input.root";
+    std::ofstream(input.c_str()) << "input";
+    string dir = directory + "/zones";
+
+    ZoneMap map(dir, "1");
+    ZoneMap::File f;
+    Check(!map.Load(input, f), "map: none before a run");
+    map.Store(input, MakeFile(20, {MakeZone(0, 10, {1}), MakeZone(10, 20, {3})}));
+    Check(map.Load(input, f) && f.zones.size() == 2 && f.total.last == 20 && f.rules.size() == 2, "map: loaded as stored");
+    Check(f.rules[0] == MakeRule('>', 2) && f.zones[1].high[0] == 3, "map: rules and ranges survive");
+    ZoneMap::File g;
+    Check(!ZoneMap(dir, "2").Load(input, g), "map: another selection version has its own maps");
+
+    // a second file, run in three ranges out of order
+    string other = directory + "/other.root";
+    std::ofstream(other.c_str()) << "other";
+    Check(!map.StorePiece(other, MakeFile(30, {MakeZone(10, 20, {2})})), "pieces: one range is no map");
+    Check(!map.StorePiece(other, MakeFile(30, {MakeZone(20, 25, {2}), MakeZone(25, 30, {4})})), "pieces: a gap is no map");
+    Check(!map.Load(other, g), "pieces: not loaded before they cover the file");
+    Check(map.StorePiece(other, MakeFile(30, {MakeZone(0, 10, {1})})), "pieces: the last range makes the map");
+    Check(map.Load(other, g) && g.zones.size() == 4 && g.total.first == 0 && g.total.last == 30, "pieces: joined in entry order");
+    Check(g.total.low[0] == 1 && g.total.high[0] == 4 && g.total.cutflow[0] == 30, "pieces: the total spans every piece");
+
+    std::system(("rm -rf " + dir + " " + input + " " + other).c_str());
+}
+
+int main() {
+    char directory[] = "/tmp/testZoneMapXXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        return 1;
+    Zones();
+    Maps(directory);
+    rmdir(directory);
+
+    if (failures == 0)
+        std::cout << "testZoneMap: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}